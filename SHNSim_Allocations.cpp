@@ -0,0 +1,111 @@
+// diagnostics only: linked into the bench, not the simulator, so that
+// threadAllocations() also counts every operator new of the bench's threads.
+// All replaceable forms are replaced, so array, nothrow and over-aligned
+// allocations are counted and freed consistently
+#include "SHNSim_Engine.h"
+#include <stdlib.h>
+#include <new>
+
+using namespace std;
+
+static void* countedAlloc(size_t size, size_t align)
+{
+	countAllocation();
+	if (size == 0)
+		size = 1;
+	if (align <= alignof(max_align_t))
+		return malloc(size);
+	// aligned_alloc wants a size that is a multiple of the alignment
+	return aligned_alloc(align, (size + align - 1) / align * align);
+}
+
+static void* countedNew(size_t size, size_t align)
+{
+	void* p = countedAlloc(size, align);
+	if (p == NULL)
+		throw bad_alloc();
+	return p;
+}
+
+void* operator new(size_t size)
+{
+	return countedNew(size, 0);
+}
+void* operator new[](size_t size)
+{
+	return countedNew(size, 0);
+}
+void* operator new(size_t size, const nothrow_t&) noexcept
+{
+	return countedAlloc(size, 0);
+}
+void* operator new[](size_t size, const nothrow_t&) noexcept
+{
+	return countedAlloc(size, 0);
+}
+void* operator new(size_t size, align_val_t align)
+{
+	return countedNew(size, (size_t)align);
+}
+void* operator new[](size_t size, align_val_t align)
+{
+	return countedNew(size, (size_t)align);
+}
+void* operator new(size_t size, align_val_t align, const nothrow_t&) noexcept
+{
+	return countedAlloc(size, (size_t)align);
+}
+void* operator new[](size_t size, align_val_t align, const nothrow_t&) noexcept
+{
+	return countedAlloc(size, (size_t)align);
+}
+
+// malloc and aligned_alloc memory are both given back with free
+void operator delete(void* p) noexcept
+{
+	free(p);
+}
+void operator delete[](void* p) noexcept
+{
+	free(p);
+}
+void operator delete(void* p, size_t) noexcept
+{
+	free(p);
+}
+void operator delete[](void* p, size_t) noexcept
+{
+	free(p);
+}
+void operator delete(void* p, const nothrow_t&) noexcept
+{
+	free(p);
+}
+void operator delete[](void* p, const nothrow_t&) noexcept
+{
+	free(p);
+}
+void operator delete(void* p, align_val_t) noexcept
+{
+	free(p);
+}
+void operator delete[](void* p, align_val_t) noexcept
+{
+	free(p);
+}
+void operator delete(void* p, size_t, align_val_t) noexcept
+{
+	free(p);
+}
+void operator delete[](void* p, size_t, align_val_t) noexcept
+{
+	free(p);
+}
+void operator delete(void* p, align_val_t, const nothrow_t&) noexcept
+{
+	free(p);
+}
+void operator delete[](void* p, align_val_t, const nothrow_t&) noexcept
+{
+	free(p);
+}
@@ -0,0 +1,391 @@
+#include "SHNSim_Batch.h"
+#include "SHNSim_Trace.h"
+#include "SHNSim_Checkpoint.h"
+#include "SHNSim_Regions.h"
+#include <stdio.h>
+#include <algorithm>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <limits>
+#include <math.h>
+#include <unistd.h>
+
+using namespace std;
+
+// task queue owned by one worker; the owner takes runs from the back and
+// idle workers steal from the front
+struct workQueue
+{
+	mutex lock;
+	deque<int> runs;
+};
+
+unsigned long long runSeed(int run)
+{
+	// splitmix64 finalizer, so neighbouring run numbers get unrelated streams
+	unsigned long long z = ((unsigned long long)run + 1) * 0x9E3779B97F4A7C15ULL;
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+	return z ^ (z >> 31);
+}
+
+static bool takeRun(vector<workQueue>& queues, int self, int& run)
+{
+	{
+		lock_guard<mutex> guard(queues[self].lock);
+		if (!queues[self].runs.empty())
+		{
+			run = queues[self].runs.back();
+			queues[self].runs.pop_back();
+			return true;
+		}
+	}
+	for (int k = 1; k < (int)queues.size(); k++)
+	{
+		workQueue& victim = queues[(self + k) % queues.size()];
+		lock_guard<mutex> guard(victim.lock);
+		if (!victim.runs.empty())
+		{
+			run = victim.runs.front();
+			victim.runs.pop_front();
+			return true;
+		}
+	}
+	return false;
+}
+
+void formatRun(const simEngine& eng, string& text)
+{
+	text = "tile,state,arrivals,served,dropped,blocked,meanDelay\n";
+	char line[192];
+	for (int i = 0; i < (int)eng.stats.size(); i++)
+	{
+		const tileStats& st = eng.stats[i];
+		snprintf(line, sizeof(line), "%i,%i,%lld,%lld,%lld,%lld,%.17g\n", i, eng.tileState[i], st.arrivals, st.served, st.dropped, st.blocked, (st.served > 0 ? st.delaySum / st.served : 0.0));
+		text += line;
+	}
+}
+
+runSummary summarizeRun(const simEngine& eng, int run)
+{
+	runSummary sum;
+	sum.run = run;
+	sum.events = eng.events;
+	sum.wallSeconds = eng.wallSeconds;
+	sum.allocations = eng.allocations;
+	for (int i = 0; i < (int)eng.stats.size(); i++)
+	{
+		sum.total.arrivals += eng.stats[i].arrivals;
+		sum.total.served += eng.stats[i].served;
+		sum.total.dropped += eng.stats[i].dropped;
+		sum.total.blocked += eng.stats[i].blocked;
+		sum.total.delaySum += eng.stats[i].delaySum;
+	}
+	return sum;
+}
+
+static void writeRun(const simEngine& eng, resultsWriter& writer, int run)
+{
+	// formatted here, written by the writer thread
+	resultsBlock* block = takeBlock(writer, run, BLOCK_SUMMARY);
+	formatRun(eng, block->text);
+	submitBlock(writer, block);
+}
+
+// packets waiting in the antenna buffers of every tile
+static void countQueued(const simEngine& eng, vector<int>& queued)
+{
+	queued.assign(eng.stats.size(), 0);
+	for (int a = 0; a < (int)eng.antTile.size(); a++)
+	{
+		queued[eng.antTile[a]] += eng.antBuffer[a].count;
+	}
+}
+
+// append one sample of every tile to the run's series block, handing the
+// block to the writer once it is full
+static void record(const simEngine& eng, const vector<int>& queued, resultsWriter& writer, resultsBlock*& block)
+{
+	for (int i = 0; i < (int)eng.stats.size(); i++)
+	{
+		const tileStats& st = eng.stats[i];
+		block->time.push_back(eng.now);
+		block->tile.push_back(i);
+		block->arrivals.push_back(st.arrivals);
+		block->served.push_back(st.served);
+		block->dropped.push_back(st.dropped);
+		block->blocked.push_back(st.blocked);
+		block->queued.push_back(queued[i]);
+		if (block->rows() >= RESULTS_BLOCK_ROWS)
+		{
+			int run = block->run;
+			submitBlock(writer, block);
+			block = takeBlock(writer, run, BLOCK_SERIES);
+		}
+	}
+}
+
+static void publish(const simEngine& eng, const vector<int>& queued, int run, spscRing<tileSample>& ring)
+{
+	for (int i = 0; i < (int)eng.stats.size(); i++)
+	{
+		const tileStats& st = eng.stats[i];
+		tileSample sample = {run, i, eng.now, st.arrivals, st.served, st.dropped, st.blocked, queued[i]};
+		if (!ring.push(sample))
+			break;	// consumer is behind; skip the rest of this snapshot
+	}
+}
+
+// arguments shared by all workers of a batch
+struct batchJob
+{
+	const simTopology& topo;
+	const simParams& params;
+	int firstRun;
+	vector<workQueue>& queues;
+	vector<runSummary>& summaries;
+	batchProgress* progress;
+	resultsWriter& writer;
+};
+
+// a run of the batch, on one event queue or split into regions
+static void startRun(batchJob& job, simEngine& eng, simRegions& group, int run)
+{
+	if (job.writer.options.regions > 1)
+		initRegions(group, job.topo, job.params, runSeed(run), job.writer.options.regions);
+	else
+		initSimulation(eng, job.topo, job.params, runSeed(run));
+}
+
+static bool stepRun(batchJob& job, simEngine& eng, simRegions& group, double until)
+{
+	if (job.writer.options.regions > 1)
+		return stepRegions(group, until);
+	return stepSimulation(eng, until);
+}
+
+static void saveRun(batchJob& job, simEngine& eng, simRegions& group, const string& fileName, uint64_t seriesRows)
+{
+	if (job.writer.options.regions > 1)
+		saveRegions(group, fileName, seriesRows);
+	else
+		saveCheckpoint(eng, fileName, seriesRows);
+}
+
+// continue from the snapshot a run left behind, if any
+static bool resumeRun(batchJob& job, simEngine& eng, simRegions& group, int run, const string& fileName, uint64_t& seriesRows)
+{
+	if (job.writer.options.regions <= 1)
+		return access(fileName.c_str(), F_OK) == 0 && loadCheckpoint(eng, fileName, &seriesRows);
+	if (access(regionFileName(fileName, 0, (int)group.engines.size()).c_str(), F_OK) != 0)
+		return false;
+	if (loadRegions(group, fileName, &seriesRows))
+		return true;
+	startRun(job, eng, group, run);
+	return false;
+}
+
+// get the time series of a resumed run back to its snapshot: the rows written
+// before it are kept, anything written after it is cut off
+static bool resumeSeries(batchJob& job, const simEngine& state, int run, uint64_t seriesRows)
+{
+	uint64_t rows = (uint64_t)floor(state.now / job.writer.options.interval) * state.stats.size();
+	if (seriesRows != rows)
+	{
+		printf("%s was taken with another seriesInterval\n", checkpointFileName(job.writer.simName, run).c_str());
+		return false;
+	}
+	if (rows == 0)
+		return true;	// the file is simply started again
+	if (!trimSeries(job.writer.simName, run, job.writer.options.csv, rows))
+		return false;
+	submitBlock(job.writer, takeBlock(job.writer, run, BLOCK_RESUME));
+	return true;
+}
+
+// hand the samples taken so far to disk before a snapshot counts them;
+// returns the rows now in the run's series file
+static uint64_t flushSeries(resultsWriter& writer, resultsBlock*& block, uint64_t rows)
+{
+	if (block == NULL)
+		return 0;
+	int run = block->run;
+	if (block->rows() > 0)
+	{
+		submitBlock(writer, block);
+		block = takeBlock(writer, run, BLOCK_SERIES);
+	}
+	syncSeries(writer, run);
+	return rows;
+}
+
+static void removeRun(batchJob& job, simRegions& group, const string& fileName)
+{
+	if (job.writer.options.regions > 1)
+		removeRegions(group, fileName);
+	else
+		remove(fileName.c_str());
+}
+
+static void worker(batchJob& job, int self)
+{
+	// one engine per worker, so its buffers are reused from run to run; a run
+	// split into regions runs on the group instead and is read from its view
+	simEngine eng;
+	simRegions group;
+	bool split = (job.writer.options.regions > 1);
+	simEngine& state = (split ? group.view : eng);
+	vector<int> queued;
+	const double never = numeric_limits<double>::infinity();
+	double sampleEvery = job.writer.options.interval;
+	double checkpointEvery = job.writer.options.checkpoint;
+	if (traceOn.load(memory_order_relaxed))
+	{
+		char name[32];
+		snprintf(name, sizeof(name), "batch worker %i", self);
+		traceThreadName(name);
+	}
+	int run;
+	while (takeRun(job.queues, self, run))
+	{
+		TRACE_SCOPE("run");
+		string checkpointFile = checkpointFileName(job.writer.simName, run);
+		if (!split && job.progress == NULL && sampleEvery <= 0 && checkpointEvery <= 0)
+		{
+			runSimulation(eng, job.topo, job.params, runSeed(run));
+		}
+		else
+		{
+			// advance in slices, stopping at every progress report, time series
+			// sample and snapshot; the boundaries are multiples of each interval.
+			// A run that left a snapshot behind continues from it, and its time
+			// series from the rows written before the snapshot; if those are
+			// not all there the run starts over
+			startRun(job, eng, group, run);
+			uint64_t seriesRows = 0;
+			if (checkpointEvery > 0 && resumeRun(job, eng, group, run, checkpointFile, seriesRows))
+			{
+				if (sampleEvery > 0 && !resumeSeries(job, state, run, seriesRows))
+				{
+					printf("Run %i starts over\n", run);
+					startRun(job, eng, group, run);
+				}
+				else
+				{
+					printf("Run %i resumed at %.0f s from %s\n", run, state.now, checkpointFile.c_str());
+				}
+			}
+			resultsBlock* block = (sampleEvery > 0 ? takeBlock(job.writer, run, BLOCK_SERIES) : NULL);
+			long long samples = (sampleEvery > 0 ? (long long)floor(state.now / sampleEvery) : 0);
+			long long reports = (job.progress != NULL ? (long long)floor(state.now / job.progress->interval) : 0);
+			long long checkpoints = (checkpointEvery > 0 ? (long long)floor(state.now / checkpointEvery) : 0);
+			long long reported = state.events, reportedAllocations = state.allocations;
+			double nextSample = (sampleEvery > 0 ? (samples + 1) * sampleEvery : never);
+			double nextReport = (job.progress != NULL ? (reports + 1) * job.progress->interval : never);
+			double nextCheckpoint = (checkpointEvery > 0 ? (checkpoints + 1) * checkpointEvery : never);
+			bool more = true;
+			while (more && !(job.progress != NULL && job.progress->cancel.load(memory_order_relaxed)))
+			{
+				{
+					TRACE_SCOPE("stepSimulation");
+					more = stepRun(job, eng, group, min(min(nextSample, nextReport), nextCheckpoint));
+				}
+				bool sample = (state.now >= nextSample);
+				bool report = (state.now >= nextReport || (!more && job.progress != NULL));
+				if (sample || report)
+					countQueued(state, queued);
+				if (sample)
+				{
+					record(state, queued, job.writer, block);
+					nextSample = (++samples + 1) * sampleEvery;
+				}
+				if (report)
+				{
+					batchProgress& progress = *job.progress;
+					long long events = progress.events.fetch_add(state.events - reported, memory_order_relaxed);
+					TRACE_COUNTER("sim events", events + state.events - reported);
+					reported = state.events;
+					long long allocations = progress.allocations.fetch_add(state.allocations - reportedAllocations, memory_order_relaxed);
+					TRACE_COUNTER("event loop allocations", allocations + state.allocations - reportedAllocations);
+					reportedAllocations = state.allocations;
+					publish(state, queued, run, *progress.rings[self]);
+					nextReport = (++reports + 1) * progress.interval;
+				}
+				if (state.now >= nextCheckpoint && more)
+				{
+					TRACE_SCOPE("saveCheckpoint");
+					saveRun(job, eng, group, checkpointFile, flushSeries(job.writer, block, samples * state.stats.size()));
+					nextCheckpoint = (++checkpoints + 1) * checkpointEvery;
+				}
+			}
+			// cancelled; keep where the run got to, so it can be resumed
+			if (more && checkpointEvery > 0)
+				saveRun(job, eng, group, checkpointFile, flushSeries(job.writer, block, samples * state.stats.size()));
+			if (block != NULL)
+				submitBlock(job.writer, block);
+			submitBlock(job.writer, takeBlock(job.writer, run, BLOCK_END));
+			if (more)
+				return;
+			if (checkpointEvery > 0)
+				removeRun(job, group, checkpointFile);
+			if (job.progress != NULL)
+				job.progress->runsDone.fetch_add(1, memory_order_relaxed);
+		}
+		writeRun(state, job.writer, run);
+
+		job.summaries[run - job.firstRun] = summarizeRun(state, run);
+		TRACE_COUNTER("sim events/s per thread", (long long)(state.events / max(state.wallSeconds, 1e-9)));
+	}
+}
+
+int batchThreads(int threads, int runs, int regions)
+{
+	if (threads <= 0)
+		threads = max(1, (int)thread::hardware_concurrency() / max(1, regions));
+	return max(1, min(threads, runs));
+}
+
+void resetProgress(batchProgress& progress, int threads, size_t ringCapacity)
+{
+	progress.rings.clear();
+	for (int t = 0; t < threads; t++)
+	{
+		progress.rings.push_back(unique_ptr<spscRing<tileSample>>(new spscRing<tileSample>(ringCapacity)));
+	}
+	progress.events = 0;
+	progress.allocations = 0;
+	progress.runsDone = 0;
+	progress.cancel = false;
+	progress.finished = false;
+}
+
+vector<runSummary> runBatch(const simTopology& topo, const simParams& params, const string& simName, int firstRun, int runs, int threads, batchProgress* progress, const resultsOptions& series)
+{
+	runs = max(0, runs);
+	threads = batchThreads(threads, runs, series.regions);
+
+	// hand out contiguous blocks of runs; stealing evens out the rest
+	vector<workQueue> queues(threads);
+	for (int i = 0; i < runs; i++)
+	{
+		queues[(long long)i * threads / runs].runs.push_back(firstRun + i);
+	}
+
+	vector<runSummary> summaries(runs);
+	resultsWriter writer;
+	startResults(writer, simName, series);
+	batchJob job = {topo, params, firstRun, queues, summaries, progress, writer};
+	vector<thread> pool;
+	for (int t = 1; t < threads; t++)
+	{
+		pool.push_back(thread(worker, ref(job), t));
+	}
+	worker(job, 0);
+	for (int t = 0; t < (int)pool.size(); t++)
+	{
+		pool[t].join();
+	}
+	stopResults(writer);
+	return summaries;
+}
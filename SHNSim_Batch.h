@@ -0,0 +1,68 @@
+#ifndef SHNSIM_BATCH_H
+#define SHNSIM_BATCH_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include "SHNSim_Engine.h"
+#include "SHNSim_Ring.h"
+#include "SHNSim_Results.h"
+
+// totals of one replication of a batch
+struct runSummary
+{
+	int run = 0;
+	long long events = 0;
+	double wallSeconds = 0;
+	long long allocations = 0;	// heap allocations made inside the event loop
+	tileStats total;
+};
+
+// snapshot of one tile of a running replication
+struct tileSample
+{
+	int run;
+	int tile;
+	double time;	// simulated time of the snapshot
+	long long arrivals, served, dropped, blocked;
+	int queued;	// packets waiting in the tile's antenna buffers
+};
+
+// live progress of a batch; every worker publishes tile samples into its own
+// ring (so each ring has exactly one producer) and drops them when it is full
+struct batchProgress
+{
+	double interval = 60;	// simulated seconds between samples
+	std::vector<std::unique_ptr<spscRing<tileSample>>> rings;	// one per worker
+	std::atomic<long long> events{0};
+	std::atomic<long long> allocations{0};	// heap allocations made inside the event loops
+	std::atomic<int> runsDone{0};
+	std::atomic<bool> cancel{false};	// set by the consumer to abandon the batch
+	std::atomic<bool> finished{false};	// set by the caller once runBatch() has returned
+};
+
+// number of workers runBatch() uses for "threads" (0 = one per core, shared
+// by the "regions" threads of every run) and "runs"
+int batchThreads(int threads, int runs, int regions = 1);
+
+// clear a progress block and give it one ring per worker
+void resetProgress(batchProgress& progress, int threads, size_t ringCapacity);
+
+// seed of a replication; depends only on the run number
+unsigned long long runSeed(int run);
+
+// per-tile summary CSV of a finished run ("<simName>_<run>.csv")
+void formatRun(const simEngine& eng, std::string& text);
+
+// totals of a finished run
+runSummary summarizeRun(const simEngine& eng, int run);
+
+// run replications firstRun .. firstRun + runs - 1 on a work-stealing pool of
+// "threads" workers (0 = one per core); summaries are returned in run order.
+// If progress is given it must have been reset for batchThreads(threads, runs, series.regions).
+// Result files are written by a separate writer thread, which runBatch() waits
+// for before it returns
+std::vector<runSummary> runBatch(const simTopology& topo, const simParams& params, const std::string& simName, int firstRun, int runs, int threads, batchProgress* progress = NULL, const resultsOptions& series = resultsOptions());
+
+#endif
@@ -0,0 +1,201 @@
+// build: g++ -O2 -pthread -o SHNSim_Bench SHNSim_Bench.cpp SHNSim_Layout.cpp SHNSim_Engine.cpp SHNSim_Batch.cpp SHNSim_Results.cpp SHNSim_Healing.cpp SHNSim_Trace.cpp SHNSim_Generate.cpp SHNSim_Checkpoint.cpp SHNSim_Sweep.cpp SHNSim_Random.cpp SHNSim_Regions.cpp SHNSim_Allocations.cpp `pkg-config --cflags --libs gtk+-3.0`
+//
+// benchmarks of the drawing window's hot paths and the engine's antenna packet
+// buffers on generated grids of 10 to 100k tiles:
+//     SHNSim_Bench [max tiles] > results.jsonl
+// SHNSim_GUI.cpp is compiled into this file (without its main()), so the real
+// static functions are timed. GTK is linked but never initialized and drawing
+// goes to a cairo image surface, so no display is needed.
+// Every measurement is printed as one JSON object per line:
+//     {"bench": "getNeighbors", "tiles": 1000, "iterations": 2048, "nsPerOp": 51234.5}
+
+#define SHNSIM_BENCH
+#include "SHNSim_GUI.cpp"
+#include <stdlib.h>
+#include <chrono>
+#include <functional>
+#include <deque>
+
+// shortest total time a measurement runs for
+static const double BENCH_MIN_SECONDS = 0.2;
+
+// fill glob with a hexagonal spiral of "tiles" tiles around (0,0)
+static void makeGrid(int tiles)
+{
+	// axial directions in the order a ring is walked
+	static const int ringDir[6][2] = {{1, 0}, {1, -1}, {0, -1}, {-1, 0}, {-1, 1}, {0, 1}};
+
+	glob.axial.clear();
+	glob.axial.push_back(make_pair(0, 0));
+	for (int ring = 1; (int)glob.axial.size() < tiles; ring++)
+	{
+		// start "ring" steps out along the fifth direction and walk all six sides
+		int q = ringDir[4][0] * ring, r = ringDir[4][1] * ring;
+		for (int k = 0; k < 6; k++)
+		{
+			for (int j = 0; j < ring && (int)glob.axial.size() < tiles; j++)
+			{
+				glob.axial.push_back(make_pair(q, r));
+				q += ringDir[k][0];
+				r += ringDir[k][1];
+			}
+		}
+	}
+	glob.count = tiles;
+	glob.state.assign(tiles, 0);
+	glob.path.assign(tiles, 7);
+	glob.selectedTile = 0;
+	glob.highlightedSide = 0;
+	indexTiles();
+	computeBounds();
+	fitView();
+}
+
+// time "op" until it has run for BENCH_MIN_SECONDS, doubling the batch size
+static void measure(const char* name, int tiles, const function<void()>& op)
+{
+	long long iterations = 1, total = 0;
+	double seconds = 0;
+	op();	// warm up caches and lazily built state
+	while (seconds < BENCH_MIN_SECONDS)
+	{
+		chrono::steady_clock::time_point start = chrono::steady_clock::now();
+		for (long long i = 0; i < iterations; i++)
+		{
+			op();
+		}
+		seconds += chrono::duration<double>(chrono::steady_clock::now() - start).count();
+		total += iterations;
+		iterations *= 2;
+	}
+	printf("{\"bench\": \"%s\", \"tiles\": %i, \"iterations\": %lld, \"nsPerOp\": %.1f}\n", name, tiles, total, seconds * 1e9 / total);
+	fflush(stdout);
+}
+
+int main(int argc, char** argv)
+{
+	int maxTiles = (argc > 1 ? atoi(argv[1]) : 100000);
+
+	// drawing area of a 1920 x 1080 screen, as set up by setUpDrawingWindow()
+	glob.screenWidth = 1920 - 80;
+	glob.screenHeight = 1080 - 58;
+	int width = (int)(glob.screenWidth * 0.95), height = (int)(glob.screenHeight * 0.95);
+	cairo_surface_t* target = cairo_image_surface_create(CAIRO_FORMAT_RGB24, width, height);
+	cairo_t* cr = cairo_create(target);
+
+	// fixed pseudo random pointer positions inside the drawing area
+	vector<coord> points(4096);
+	unsigned long long seed = 1;
+	for (int i = 0; i < (int)points.size(); i++)
+	{
+		seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+		points[i].x = (seed >> 33) % width;
+		points[i].y = (seed >> 13) % height;
+	}
+
+	static const int sizes[5] = {10, 100, 1000, 10000, 100000};
+	for (int s = 0; s < 5 && sizes[s] <= maxTiles; s++)
+	{
+		int tiles = sizes[s];
+		makeGrid(tiles);
+		int next = 0;
+		long long sink = 0;
+
+		measure("getNeighbors", tiles, [&] { getNeighbors(); });
+
+		// the check right after an edit rebuilds the neighbors and cut tiles
+		measure("deletionValid", tiles, [&]
+		{
+			glob.topologyStale = true;
+			sink += deletionValid(next);
+			next = (next + 7919) % tiles;
+		});
+		measure("deletionValidCached", tiles, [&]
+		{
+			sink += deletionValid(next);
+			next = (next + 7919) % tiles;
+		});
+
+		// what an add or delete does to fit the grid back into the window
+		measure("fit", tiles, [&]
+		{
+			computeBounds();
+			fitView();
+		});
+
+		measure("hitTest", tiles, [&]
+		{
+			const coord& p = points[next++ & (points.size() - 1)];
+			sink += hitTest(p.x, p.y).tile;
+		});
+
+		// full redraw after a change of the grid, and the cached redraw a hover does
+		measure("drawHex", tiles, [&]
+		{
+			gridLayer.stale = true;
+			drawHex(cr);
+		});
+		measure("drawHexCached", tiles, [&] { drawHex(cr); });
+
+		// full redraw zoomed in to labeled tiles around the middle of the grid,
+		// which should take about as long for every grid size
+		double fitSide = glob.sideLength;
+		zoomView(48.0 / fitSide, width / 2.0, height / 2.0);
+		measure("drawHexZoomed", tiles, [&]
+		{
+			gridLayer.stale = true;
+			drawHex(cr);
+		});
+		fitView();
+
+		// the engine's antenna buffers (3 per tile, 10 packets each, half full):
+		// an arrival queues a packet at one antenna and a departure takes one
+		// from another, the pattern of the event loop. The deque is the
+		// container the buffers replaced
+		int antennas = 3 * tiles, bufSize = 10, stride = bufferStride(bufSize);
+		vector<packetBuffer> buffers(antennas);
+		vector<double> slots((size_t)antennas * stride);
+		vector<deque<double>> queues(antennas);
+		for (int a = 0; a < antennas; a++)
+		{
+			for (int i = 0; i < bufSize / 2; i++)
+			{
+				bufferPush(buffers[a], &slots[(size_t)a * stride], bufSize, stride - 1, i);
+				queues[a].push_back(i);
+			}
+		}
+		int from = antennas / 2;
+		next = 0;
+		measure("packetBuffer", tiles, [&]
+		{
+			bufferPush(buffers[next], &slots[(size_t)next * stride], bufSize, stride - 1, next);
+			if (buffers[from].count > 0)
+				sink += (long long)bufferPop(buffers[from], &slots[(size_t)from * stride], stride - 1);
+			next = (next + 7919) % antennas;
+			from = (from + 7919) % antennas;
+		});
+		measure("packetDeque", tiles, [&]
+		{
+			if ((int)queues[next].size() < bufSize)
+				queues[next].push_back(next);
+			if (!queues[from].empty())
+			{
+				sink += (long long)queues[from].front();
+				queues[from].pop_front();
+			}
+			next = (next + 7919) % antennas;
+			from = (from + 7919) % antennas;
+		});
+
+		// printed so the compiler cannot drop the calls whose results are unused
+		fprintf(stderr, "%i tiles: checksum %lld\n", tiles, sink);
+	}
+
+	cairo_destroy(cr);
+	cairo_surface_destroy(target);
+	if (gridLayer.surface != NULL)
+		cairo_surface_destroy(gridLayer.surface);
+	if (gridLayer.cells != NULL)
+		cairo_surface_destroy(gridLayer.cells);
+	return 0;
+}
@@ -0,0 +1,58 @@
+#ifndef SHNSIM_BUFFER_H
+#define SHNSIM_BUFFER_H
+
+// fixed capacity FIFO of packet arrival times. The slots live outside the
+// buffer, in one contiguous array shared by all buffers of a run: buffer i
+// owns the power of two "stride" slots starting at i * stride, so positions
+// wrap with a mask. Antennas of a base station are numbered consecutively, so
+// the buffers (and slots) of one base station are adjacent in memory too.
+// Enqueues, dequeues and drops are counted as they happen
+struct packetBuffer
+{
+	int head = 0;	// slot of the oldest packet
+	int count = 0;	// packets waiting
+	long long enqueued = 0;
+	long long dequeued = 0;
+	long long dropped = 0;	// packets that found the buffer full
+};
+
+// smallest power of two holding "capacity" packets (at least 1)
+inline int bufferStride(int capacity)
+{
+	int stride = 1;
+	while (stride < capacity)
+		stride *= 2;
+	return stride;
+}
+
+// append a packet; drops it (and returns false) when "capacity" are waiting
+inline bool bufferPush(packetBuffer& b, double* slots, int capacity, int mask, double stamp)
+{
+	if (b.count >= capacity)
+	{
+		b.dropped++;
+		return false;
+	}
+	slots[(b.head + b.count) & mask] = stamp;
+	b.count++;
+	b.enqueued++;
+	return true;
+}
+
+// remove and return the oldest packet; the buffer must not be empty
+inline double bufferPop(packetBuffer& b, const double* slots, int mask)
+{
+	double stamp = slots[b.head];
+	b.head = (b.head + 1) & mask;
+	b.count--;
+	b.dequeued++;
+	return stamp;
+}
+
+// packet at position i (0 = oldest)
+inline double bufferAt(const packetBuffer& b, const double* slots, int mask, int i)
+{
+	return slots[(b.head + i) & mask];
+}
+
+#endif
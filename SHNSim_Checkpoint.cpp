@@ -0,0 +1,263 @@
+#include "SHNSim_Checkpoint.h"
+#include <stdio.h>
+#include <algorithm>
+#include <string.h>
+#include <unistd.h>
+
+using namespace std;
+
+static const size_t FILE_BUFFER = 1 << 20;
+
+string checkpointFileName(const string& simName, int run)
+{
+	return simName + "_" + to_string(run) + ".ckpt";
+}
+
+template <class V>
+static void hashVector(uint64_t& h, const V& v)
+{
+	h = hashBytes(h, v.data(), v.size() * sizeof(v[0]));
+}
+
+uint64_t modelFingerprint(const simEngine& eng)
+{
+	uint64_t h = 0x243F6A8885A308D3ULL;
+	hashVector(h, eng.tileId);
+	hashVector(h, eng.tileState);
+	hashVector(h, eng.antTile);
+	hashVector(h, eng.ueAntenna);
+	hashVector(h, eng.ueRate);
+	hashVector(h, eng.ueAlt);
+	h = hashBytes(h, &eng.serversPerAntenna, sizeof(eng.serversPerAntenna));
+	h = hashBytes(h, &eng.meanService, sizeof(eng.meanService));
+	h = hashBytes(h, &eng.airDelay, sizeof(eng.airDelay));
+	h = hashBytes(h, &eng.params.bufSize, sizeof(eng.params.bufSize));
+	return h;
+}
+
+template <class T>
+static bool writeArray(FILE* out, const T* data, size_t count)
+{
+	return count == 0 || fwrite(data, sizeof(T), count, out) == count;
+}
+
+template <class T>
+static bool readArray(FILE* in, vector<T>& data, size_t count)
+{
+	data.resize(count);
+	return count == 0 || fread(data.data(), sizeof(T), count, in) == count;
+}
+
+template <class T>
+static void copyArray(arenaArray<T>& to, const vector<T>& from)
+{
+	to.count = from.size();
+	if (!from.empty())
+		memcpy(to.items, from.data(), from.size() * sizeof(T));
+}
+
+bool saveCheckpoint(const simEngine& eng, const string& fileName, uint64_t seriesRows)
+{
+	string temp = fileName + ".tmp";
+	FILE* out = fopen(temp.c_str(), "wb");
+	if (out == NULL)
+	{
+		printf("Could not open %s for writing\n", temp.c_str());
+		return false;
+	}
+	setvbuf(out, NULL, _IOFBF, FILE_BUFFER);
+
+	int antennas = (int)eng.antTile.size();
+	vector<double> heapTime(eng.heap.size());
+	vector<int32_t> heapEvent(eng.heap.size());
+	for (size_t i = 0; i < eng.heap.size(); i++)
+	{
+		heapTime[i] = eng.heap[i].time;
+		heapEvent[i] = eng.heap[i].event;
+	}
+	vector<packetBuffer> buffers(eng.antBuffer.begin(), eng.antBuffer.end());
+	vector<double> queued;
+	for (int a = 0; a < antennas; a++)
+	{
+		// oldest packet first, wherever the buffer's ring starts
+		for (int i = 0; i < buffers[a].count; i++)
+		{
+			queued.push_back(bufferAt(buffers[a], antennaSlots(eng, a), eng.slotMask, i));
+		}
+		buffers[a].head = 0;
+	}
+
+	checkpointHeader head;
+	memset(&head, 0, sizeof(head));
+	memcpy(head.magic, CHECKPOINT_MAGIC, 4);
+	head.version = CHECKPOINT_VERSION;
+	head.byteOrder = CHECKPOINT_BYTE_ORDER;
+	head.tiles = (uint32_t)eng.tileState.size();
+	head.antennas = (uint32_t)antennas;
+	head.ues = (uint32_t)eng.ueAntenna.size();
+	head.model = modelFingerprint(eng);
+	head.now = eng.now;
+	head.events = eng.events;
+	head.wallSeconds = eng.wallSeconds;
+	head.heapSize = eng.heap.size();
+	head.poolSize = eng.pool.size();
+	head.freeSize = eng.freeEvents.size();
+	head.queuedTotal = queued.size();
+	head.seriesRows = seriesRows;
+
+	bool ok = writeArray(out, &head, 1)
+		&& writeArray(out, heapTime.data(), heapTime.size())
+		&& writeArray(out, heapEvent.data(), heapEvent.size())
+		&& writeArray(out, eng.pool.data(), eng.pool.size())
+		&& writeArray(out, eng.freeEvents.data(), eng.freeEvents.size())
+		&& writeArray(out, eng.stats.data(), eng.stats.size())
+		&& writeArray(out, eng.tileRng.data(), eng.tileRng.size())
+		&& writeArray(out, eng.antBusy.data(), eng.antBusy.size())
+		&& writeArray(out, buffers.data(), buffers.size())
+		&& writeArray(out, queued.data(), queued.size());
+
+	// the data has to be on disk before the rename makes it the snapshot
+	ok = (fflush(out) == 0) && ok;
+	ok = (fsync(fileno(out)) == 0) && ok;
+	ok = (fclose(out) == 0) && ok;
+	if (!ok || rename(temp.c_str(), fileName.c_str()) != 0)
+	{
+		printf("Could not write %s\n", fileName.c_str());
+		remove(temp.c_str());
+		return false;
+	}
+	return true;
+}
+
+bool loadCheckpoint(simEngine& eng, const string& fileName, uint64_t* seriesRows)
+{
+	FILE* in = fopen(fileName.c_str(), "rb");
+	if (in == NULL)
+	{
+		printf("Could not open %s\n", fileName.c_str());
+		return false;
+	}
+	setvbuf(in, NULL, _IOFBF, FILE_BUFFER);
+
+	checkpointHeader head;
+	if (fread(&head, sizeof(head), 1, in) != 1 || memcmp(head.magic, CHECKPOINT_MAGIC, 4) != 0)
+	{
+		printf("%s is not a checkpoint\n", fileName.c_str());
+		fclose(in);
+		return false;
+	}
+	if (head.version != CHECKPOINT_VERSION || head.byteOrder != CHECKPOINT_BYTE_ORDER)
+	{
+		printf("%s: checkpoint version %u is not supported or was written with a different byte order\n", fileName.c_str(), head.version);
+		fclose(in);
+		return false;
+	}
+	int antennas = (int)eng.antTile.size();
+	if (head.tiles != eng.tileState.size() || head.antennas != (uint32_t)antennas || head.ues != eng.ueAntenna.size() || head.model != modelFingerprint(eng))
+	{
+		printf("%s was taken of a different network, parameter set or run\n", fileName.c_str());
+		fclose(in);
+		return false;
+	}
+
+	// the engine's arrays were sized for the most this model can ever hold, so
+	// larger counts are damage and are refused before anything is allocated
+	if (head.heapSize < 3 || head.heapSize > eng.heap.capacity || head.poolSize > eng.pool.capacity || head.freeSize > eng.freeEvents.capacity
+		|| head.queuedTotal > (uint64_t)antennas * (uint64_t)max(0, eng.params.bufSize))
+	{
+		printf("%s is damaged\n", fileName.c_str());
+		fclose(in);
+		return false;
+	}
+
+	// everything is read into copies first, so a short file changes nothing
+	vector<double> heapTime, queued;
+	vector<int32_t> heapEvent, freeEvents, antBusy;
+	vector<packetBuffer> buffers;
+	vector<simEvent> pool;
+	vector<tileStats> stats;
+	vector<rngStream> rng;
+	bool ok = readArray(in, heapTime, head.heapSize)
+		&& readArray(in, heapEvent, head.heapSize)
+		&& readArray(in, pool, head.poolSize)
+		&& readArray(in, freeEvents, head.freeSize)
+		&& readArray(in, stats, head.tiles)
+		&& readArray(in, rng, head.tiles)
+		&& readArray(in, antBusy, head.antennas)
+		&& readArray(in, buffers, head.antennas)
+		&& readArray(in, queued, head.queuedTotal);
+	fclose(in);
+
+	uint64_t total = 0;
+	for (int a = 0; ok && a < antennas; a++)
+	{
+		ok = (buffers[a].count >= 0 && buffers[a].count <= eng.params.bufSize);
+		total += buffers[a].count;
+	}
+	for (size_t i = 0; ok && i < heapEvent.size(); i++)
+	{
+		ok = (heapEvent[i] >= 0 && (uint64_t)heapEvent[i] < head.poolSize);
+	}
+	for (size_t i = 0; ok && i < rng.size(); i++)
+	{
+		ok = (rng[i].next >= 0 && rng[i].next <= RNG_BATCH);
+	}
+
+	// every event of the pool is either scheduled (past the three padding
+	// entries of the heap) or free, once; a scheduled event targets a UE or an
+	// antenna of this engine, and every busy transceiver has its departure
+	int ues = (int)eng.ueAntenna.size();
+	vector<char> held(head.poolSize, 0);
+	vector<int32_t> departures(antennas, 0);
+	for (size_t i = 3; ok && i < heapEvent.size(); i++)
+	{
+		const simEvent& ev = pool[heapEvent[i]];
+		ok = (!held[heapEvent[i]] && ((ev.type == EVENT_ARRIVAL && ev.target >= 0 && ev.target < ues) || (ev.type == EVENT_DEPARTURE && ev.target >= 0 && ev.target < antennas)));
+		held[heapEvent[i]] = 1;
+		if (ok && ev.type == EVENT_DEPARTURE)
+			departures[ev.target]++;
+	}
+	for (size_t i = 0; ok && i < freeEvents.size(); i++)
+	{
+		ok = (freeEvents[i] >= 0 && (uint64_t)freeEvents[i] < head.poolSize && !held[freeEvents[i]]);
+		if (ok)
+			held[freeEvents[i]] = 1;
+	}
+	ok = ok && (head.heapSize - 3) + head.freeSize == head.poolSize;
+	for (int a = 0; ok && a < antennas; a++)
+	{
+		ok = (antBusy[a] >= 0 && antBusy[a] <= eng.serversPerAntenna && antBusy[a] == departures[a]);
+	}
+	if (!ok || total != head.queuedTotal)
+	{
+		printf("%s is damaged\n", fileName.c_str());
+		return false;
+	}
+
+	eng.now = head.now;
+	eng.events = head.events;
+	eng.wallSeconds = head.wallSeconds;
+	eng.heap.resize(head.heapSize);
+	for (size_t i = 0; i < heapTime.size(); i++)
+	{
+		eng.heap[i].time = heapTime[i];
+		eng.heap[i].event = heapEvent[i];
+	}
+	copyArray(eng.pool, pool);
+	copyArray(eng.freeEvents, freeEvents);
+	copyArray(eng.stats, stats);
+	copyArray(eng.tileRng, rng);
+	copyArray(eng.antBusy, antBusy);
+	copyArray(eng.antBuffer, buffers);
+	size_t next = 0;
+	for (int a = 0; a < antennas; a++)
+	{
+		for (int i = 0; i < buffers[a].count; i++)
+		{
+			antennaSlots(eng, a)[i] = queued[next++];
+		}
+	}
+	if (seriesRows != NULL)
+		*seriesRows = head.seriesRows;
+	return true;
+}
@@ -0,0 +1,53 @@
+#ifndef SHNSIM_CHECKPOINT_H
+#define SHNSIM_CHECKPOINT_H
+
+#include <string>
+#include <stdint.h>
+#include "SHNSim_Engine.h"
+
+// Snapshot of a running replication, "<simName>_<run>.ckpt", in native byte order:
+//   checkpointHeader
+//   double heapTime[heapSize], int32 heapEvent[heapSize]	(scheduler, as laid out in memory)
+//   simEvent pool[poolSize], int32 freeEvents[freeSize]
+//   tileStats stats[tiles], rngStream rng[tiles]
+//   int32 antBusy[antennas], packetBuffer buffers[antennas], double queued[queuedTotal]
+// The buffers are stored with head 0 and their packets in queued, oldest first
+// Only the state that changes while a run goes on is stored. The UE/antenna
+// model is rebuilt by initSimulation() from the topology, parameters and seed,
+// and the header's fingerprint of that model has to match before a snapshot is
+// restored. A restored run continues bit for bit as if it had never stopped
+static const char CHECKPOINT_MAGIC[4] = {'S', 'H', 'N', 'C'};
+static const uint32_t CHECKPOINT_VERSION = 6;
+static const uint32_t CHECKPOINT_BYTE_ORDER = 0x01020304;
+
+struct checkpointHeader
+{
+	char magic[4];
+	uint32_t version;
+	uint32_t byteOrder;	// CHECKPOINT_BYTE_ORDER as written by the saving machine
+	uint32_t tiles, antennas, ues;	// as numbered in the engine
+	uint64_t model;	// modelFingerprint() of the engine
+	double now;
+	int64_t events;
+	double wallSeconds;
+	uint64_t heapSize, poolSize, freeSize, queuedTotal;
+	uint64_t seriesRows;	// rows of the run's time series on disk when the snapshot was taken
+};
+
+std::string checkpointFileName(const std::string& simName, int run);
+
+// hash of everything initSimulation() derives from the topology, parameters and
+// seed; simLen is left out, so a resumed run may be given a longer length
+uint64_t modelFingerprint(const simEngine& eng);
+
+// write the snapshot to "<fileName>.tmp" and rename it over fileName, so a crash
+// while saving leaves the previous snapshot intact; seriesRows is kept for the
+// resumed run to cut its time series file back to
+bool saveCheckpoint(const simEngine& eng, const std::string& fileName, uint64_t seriesRows = 0);
+
+// restore a snapshot into an engine just set up by initSimulation(); fails (with
+// a message on stdout, leaving the engine as it was) on a damaged file or one
+// taken of a different model
+bool loadCheckpoint(simEngine& eng, const std::string& fileName, uint64_t* seriesRows = NULL);
+
+#endif
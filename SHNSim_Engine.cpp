@@ -0,0 +1,408 @@
+#include "SHNSim_Engine.h"
+#include <math.h>
+#include <algorithm>
+#include <chrono>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <new>
+
+using namespace std;
+
+// Traffic model
+//  - every tile has antNum antennas and every antenna uePerAnt UEs; congested
+//    tiles (state 1) carry a second set of uePerAnt UEs, alt congested tiles
+//    (state 2) switch that second set on and off every ALT_PERIOD seconds, all
+//    on the same clock (on first)
+//  - a UE generates packets as a Poisson process with a rate drawn uniformly
+//    from [1, dRateMax] packets per second
+//  - an antenna has max(1, transNum / antNum) transceivers serving packets in
+//    parallel; together they can carry dRateMax * uePerAnt packets per second
+//  - packets waiting for a transceiver are held in a buffer of bufSize packets
+//    and dropped when it is full; packets of a down tile (state 3) are blocked
+//  - every delivered packet spends bsLen * transDist seconds in the air
+//  - every tile draws from its own random streams (SHNSim_Random.h): rates and
+//    first packets of its UEs from one, the gaps and service times of the
+//    packets its antennas handle from another
+//  - with self-healing on, the share of a tile's UEs handed over to a neighbor
+//    (see SHNSim_Healing.h) is served by that neighbor's antennas instead; a
+//    moved UE keeps the alt congested period of its own tile
+
+static const int HEAP_ROOT = 3;
+
+// allocations of the calling thread: the engine counts its own arena growth,
+// the bench's operator new hook (SHNSim_Allocations.cpp) adds every new
+static thread_local long long allocationCount = 0;
+
+void countAllocation()
+{
+	allocationCount++;
+}
+
+long long threadAllocations()
+{
+	return allocationCount;
+}
+
+void arenaReset(simArena& arena, size_t bytes)
+{
+	arena.used = 0;
+	if (bytes <= arena.capacity)
+		return;
+	// the arena only grows, so runs of the same size never allocate again
+	free(arena.base);
+	arena.base = (char*)aligned_alloc(64, bytes);
+	if (arena.base == NULL)
+	{
+		arena.capacity = 0;
+		throw bad_alloc();
+	}
+	arena.capacity = bytes;
+	countAllocation();
+}
+
+void* arenaTake(simArena& arena, size_t bytes)
+{
+	if (arena.used + bytes > arena.capacity)
+	{
+		printf("arena of %zu bytes is too small for %zu more\n", arena.capacity, bytes);
+		abort();
+	}
+	void* p = arena.base + arena.used;
+	arena.used += bytes;
+	return p;
+}
+
+static inline void siftUp(simEngine& eng, int i, heapEntry e)
+{
+	while (i > HEAP_ROOT)
+	{
+		int p = (i - 4) / 4 + HEAP_ROOT;
+		if (eng.heap[p].time <= e.time)
+			break;
+		eng.heap[i] = eng.heap[p];
+		i = p;
+	}
+	eng.heap[i] = e;
+}
+static inline void siftDown(simEngine& eng, int i, heapEntry e)
+{
+	int size = (int)eng.heap.size();
+	while (true)
+	{
+		int c = 4 * i - 8;
+		if (c >= size)
+			break;
+		int best;
+		if (c + 4 <= size)
+		{
+			// full group of siblings: pick the smallest without data dependent branches
+			const heapEntry* h = &eng.heap[c];
+			int a = (h[1].time < h[0].time);
+			int b = 2 + (h[3].time < h[2].time);
+			best = c + (h[b].time < h[a].time ? b : a);
+		}
+		else
+		{
+			best = c;
+			for (int j = c + 1; j < size; j++)
+			{
+				if (eng.heap[j].time < eng.heap[best].time)
+					best = j;
+			}
+		}
+		if (eng.heap[best].time >= e.time)
+			break;
+		eng.heap[i] = eng.heap[best];
+		i = best;
+	}
+	eng.heap[i] = e;
+}
+static void schedule(simEngine& eng, int event, double time)
+{
+	heapEntry e = {time, event};
+	eng.heap.push_back(e);
+	siftUp(eng, (int)eng.heap.size() - 1, e);
+}
+static int newEvent(simEngine& eng, int type, int target, double stamp)
+{
+	simEvent ev = {type, target, stamp};
+	if (!eng.freeEvents.empty())
+	{
+		int id = eng.freeEvents.back();
+		eng.freeEvents.pop_back();
+		eng.pool[id] = ev;
+		return id;
+	}
+	eng.pool.push_back(ev);
+	return (int)eng.pool.size() - 1;
+}
+
+// event handlers return the next time of the same event, or -1 once it is finished
+static double arrival(simEngine& eng, simEvent& ev)
+{
+	int ue = ev.target;
+	int ant = eng.ueAntenna[ue];
+	int tile = eng.antTile[ant];
+	tileStats& st = eng.stats[tile];
+	rngStream& rng = eng.tileRng[tile];
+
+	if (eng.ueAlt[ue] && altQuiet(eng.now))
+	{
+		// extra UE of an alt congested tile during its quiet period
+	}
+	else if (eng.tileState[tile] == 3)
+	{
+		st.blocked++;
+	}
+	else
+	{
+		st.arrivals++;
+		if (eng.antBusy[ant] < eng.serversPerAntenna)
+		{
+			eng.antBusy[ant]++;
+			schedule(eng, newEvent(eng, EVENT_DEPARTURE, ant, eng.now), eng.now + rngExponential(rng) * eng.meanService);
+		}
+		else if (!bufferPush(eng.antBuffer[ant], antennaSlots(eng, ant), eng.params.bufSize, eng.slotMask, eng.now))
+		{
+			st.dropped++;
+		}
+	}
+	return eng.now + rngExponential(rng) / eng.ueRate[ue];
+}
+static double departure(simEngine& eng, simEvent& ev)
+{
+	int ant = ev.target;
+	tileStats& st = eng.stats[eng.antTile[ant]];
+	st.served++;
+	st.delaySum += eng.now - ev.stamp + eng.airDelay;
+
+	if (eng.antBuffer[ant].count > 0)
+	{
+		ev.stamp = bufferPop(eng.antBuffer[ant], antennaSlots(eng, ant), eng.slotMask);
+		return eng.now + rngExponential(eng.tileRng[eng.antTile[ant]]) * eng.meanService;
+	}
+	eng.antBusy[ant]--;
+	return -1;
+}
+
+void initSimulation(simEngine& eng, const simTopology& topo, const simParams& params, unsigned long long seed, const vector<char>* owned)
+{
+	int tiles = (int)topo.state.size();
+	int antNum = max(1, params.antNum);
+	int uePerAnt = max(0, params.uePerAnt);
+
+	eng.params = params;
+	eng.params.bufSize = max(0, params.bufSize);
+	eng.now = 0;
+	eng.events = 0;
+	eng.wallSeconds = 0;
+	eng.allocations = 0;
+	eng.serversPerAntenna = max(1, params.transNum / antNum);
+	eng.meanService = eng.serversPerAntenna / (double)max(1, params.dRateMax * uePerAnt);
+	eng.airDelay = params.bsLen * params.transDist;
+
+	// the engine holds the tiles it runs, their antennas and the UEs those
+	// serve: its own UEs and, with self-healing, UEs handed over to it by
+	// tiles it does not run. Size every array for the most it can hold during
+	// the run: every UE owns one event, and at most serversPerAntenna
+	// departures per antenna are pending at any time
+	bool healing = (params.selfHealing && (int)topo.handover.size() == tiles);
+	size_t ownedTiles = 0, ues = 0, homeUes = 0;
+	for (int t = 0; t < tiles; t++)
+	{
+		bool runs = (owned == NULL || (*owned)[t]);
+		bool home = runs;
+		for (int i = 0; healing && !home && i < (int)topo.handover[t].size(); i++)
+		{
+			home = ((*owned)[topo.handover[t][i].first] != 0);
+		}
+		size_t tileUes = (size_t)antNum * uePerAnt * (topo.state[t] == 1 || topo.state[t] == 2 ? 2 : 1);
+		ownedTiles += runs;
+		ues += (home ? tileUes : 0);
+		homeUes = max(homeUes, tileUes);
+	}
+	size_t antennas = ownedTiles * antNum;
+	size_t events = ues + antennas * eng.serversPerAntenna;
+	int stride = bufferStride(eng.params.bufSize);
+	eng.slotMask = stride - 1;
+	eng.slotShift = 0;
+	while ((1 << eng.slotShift) < stride)
+		eng.slotShift++;
+	size_t slots = antennas * stride;
+	arenaReset(eng.arena, arenaBytes<heapEntry>(HEAP_ROOT + events) + arenaBytes<simEvent>(events) + arenaBytes<int>(events)
+		+ 2 * arenaBytes<int>(ownedTiles) + arenaBytes<tileStats>(ownedTiles) + arenaBytes<rngStream>(ownedTiles)
+		+ 2 * arenaBytes<int>(antennas) + arenaBytes<packetBuffer>(antennas) + arenaBytes<double>(slots)
+		+ arenaBytes<int>(ues) + arenaBytes<double>(ues) + arenaBytes<char>(ues)
+		+ arenaBytes<int>(tiles) + arenaBytes<int>(homeUes) + 2 * arenaBytes<double>(homeUes));
+	arenaCarve(eng.arena, eng.heap, HEAP_ROOT + events);
+	arenaCarve(eng.arena, eng.pool, events);
+	arenaCarve(eng.arena, eng.freeEvents, events);
+	arenaCarve(eng.arena, eng.tileId, ownedTiles);
+	arenaCarve(eng.arena, eng.tileState, ownedTiles);
+	arenaCarve(eng.arena, eng.stats, ownedTiles);
+	arenaCarve(eng.arena, eng.tileRng, ownedTiles);
+	arenaCarve(eng.arena, eng.antTile, antennas);
+	arenaCarve(eng.arena, eng.antBusy, antennas);
+	arenaCarve(eng.arena, eng.antBuffer, antennas);
+	arenaCarve(eng.arena, eng.antSlots, slots);
+	arenaCarve(eng.arena, eng.ueAntenna, ues);
+	arenaCarve(eng.arena, eng.ueRate, ues);
+	arenaCarve(eng.arena, eng.ueAlt, ues);
+
+	// set-up only: engine tile of every tile (-1 if not run here), and the
+	// serving antennas, rates and first packet gaps of one tile's UEs
+	arenaArray<int> local, serving;
+	arenaArray<double> rates, starts;
+	arenaCarve(eng.arena, local, tiles);
+	arenaCarve(eng.arena, serving, homeUes);
+	arenaCarve(eng.arena, rates, homeUes);
+	arenaCarve(eng.arena, starts, homeUes);
+
+	local.assign(tiles, -1);
+	for (int t = 0; t < tiles; t++)
+	{
+		if (owned == NULL || (*owned)[t])
+		{
+			local[t] = (int)eng.tileId.size();
+			eng.tileId.push_back(t);
+			eng.tileState.push_back(topo.state[t]);
+		}
+	}
+	eng.stats.assign(ownedTiles, tileStats());
+	eng.tileRng.resize(ownedTiles);
+	for (int i = 0; i < (int)ownedTiles; i++)
+	{
+		rngInit(eng.tileRng[i], seed, eng.tileId[i], RNG_TRAFFIC);
+		for (int a = 0; a < antNum; a++)
+		{
+			eng.antTile.push_back(i);
+		}
+	}
+	eng.antBusy.assign(antennas, 0);
+	eng.antBuffer.assign(antennas, packetBuffer());
+	eng.antSlots.resize(slots);
+	eng.heap.resize(HEAP_ROOT);
+	for (int t = 0; t < tiles; t++)
+	{
+		int sets = (topo.state[t] == 1 || topo.state[t] == 2 ? 2 : 1);
+		int tileUes = antNum * uePerAnt * sets;
+
+		// the first UEs of the tile go to the neighbors it hands over to, in
+		// order, each taking its share; antennas are numbered tile * antNum + a
+		bool home = (local[t] >= 0);
+		int moved = 0, next = 0, limit = 0;
+		double share = 0;
+		serving.count = 0;
+		for (int a = 0; a < antNum; a++)
+		{
+			for (int u = 0; u < uePerAnt * sets; u++)
+			{
+				int ant = t * antNum + a;
+				if (healing)
+				{
+					while (moved >= limit && next < (int)topo.handover[t].size())
+					{
+						share += topo.handover[t][next].second;
+						limit = (int)(share * tileUes + 0.5);
+						next++;
+					}
+					if (moved < limit)
+						ant = topo.handover[t][next - 1].first * antNum + moved % antNum;
+					moved++;
+				}
+				serving.push_back(ant);
+				home = home || (local[ant / antNum] >= 0);
+			}
+		}
+		if (!home)
+			continue;
+
+		// the tile's own setup stream draws its UEs' rates and first packets,
+		// all of them, so every engine sees the same numbers; every UE served
+		// here owns one event for the whole run, departures take pooled events
+		// while a transceiver is busy
+		rngStream setup;
+		rngInit(setup, seed, t, RNG_SETUP);
+		rngFillUniform(setup, rates.data(), tileUes);
+		rngFillExponential(setup, starts.data(), tileUes);
+		for (int i = 0; i < tileUes; i++)
+		{
+			int tile = local[serving[i] / antNum];
+			if (tile < 0)
+				continue;
+			int ue = (int)eng.ueAntenna.size();
+			eng.ueAntenna.push_back(tile * antNum + serving[i] % antNum);
+			eng.ueRate.push_back(1.0 + rates[i] * max(0, params.dRateMax - 1));
+			eng.ueAlt.push_back(topo.state[t] == 2 && i % (uePerAnt * sets) >= uePerAnt);
+			schedule(eng, newEvent(eng, EVENT_ARRIVAL, ue, 0), starts[i] / eng.ueRate[ue]);
+		}
+	}
+}
+
+bool stepSimulation(simEngine& eng, double until)
+{
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	long long allocated = allocationCount;
+	until = min(until, (double)eng.params.simLen);
+
+	while ((int)eng.heap.size() > HEAP_ROOT && eng.heap[HEAP_ROOT].time <= until)
+	{
+		int id = eng.heap[HEAP_ROOT].event;
+		simEvent& ev = eng.pool[id];
+		eng.now = eng.heap[HEAP_ROOT].time;
+		eng.events++;
+
+		double next;
+		switch (ev.type)
+		{
+			case EVENT_ARRIVAL:
+				next = arrival(eng, ev);
+				break;
+			default:
+				next = departure(eng, ev);
+				break;
+		}
+
+		// handlers mostly reschedule the event they were given, so the root is
+		// replaced in place instead of a separate pop and push
+		if (next >= 0)
+		{
+			heapEntry e = {next, id};
+			siftDown(eng, HEAP_ROOT, e);
+		}
+		else
+		{
+			eng.freeEvents.push_back(id);
+			heapEntry last = eng.heap.back();
+			eng.heap.pop_back();
+			if ((int)eng.heap.size() > HEAP_ROOT)
+				siftDown(eng, HEAP_ROOT, last);
+		}
+	}
+	eng.now = max(eng.now, until);
+
+	eng.allocations += allocationCount - allocated;
+	eng.wallSeconds += chrono::duration<double>(chrono::steady_clock::now() - start).count();
+	return eng.now < eng.params.simLen;
+}
+
+void runSimulation(simEngine& eng, const simTopology& topo, const simParams& params, unsigned long long seed)
+{
+	initSimulation(eng, topo, params, seed);
+	stepSimulation(eng, params.simLen);
+}
+
+uint64_t hashBytes(uint64_t h, const void* data, size_t size)
+{
+	// multiply-xorshift, eight bytes at a time
+	const unsigned char* p = (const unsigned char*)data;
+	for (size_t i = 0; i < size; i += 8)
+	{
+		uint64_t word = 0;
+		memcpy(&word, p + i, min((size_t)8, size - i));
+		h = (h ^ word) * 0x9E3779B97F4A7C15ULL;
+		h ^= h >> 29;
+	}
+	return (h ^ size) * 0xBF58476D1CE4E5B9ULL;
+}
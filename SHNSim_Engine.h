@@ -0,0 +1,224 @@
+#ifndef SHNSIM_ENGINE_H
+#define SHNSIM_ENGINE_H
+
+#include <vector>
+#include <utility>
+#include <cstdlib>
+#include <stdint.h>
+#include "SHNSim_Buffer.h"
+#include "SHNSim_Random.h"
+
+// parameters of a single simulation run (copied out of glob by the GUI)
+struct simParams
+{
+	int bsLen = 5;
+	int antNum = 3;
+	int transNum = 100;
+	double transDist = 0.002;
+	int dRateMax = 10;
+	int uePerAnt = 10;
+	int simLen = 28800;
+	int bufSize = 10;
+	int selfHealing = 0;	// move UEs of down and congested tiles to their neighbors
+};
+
+// network the simulation runs on; neighbors hold (tile, side) pairs
+struct simTopology
+{
+	std::vector<int> state;	// 0 = healthy, 1 = congested, 2 = alt congested, 3 = down
+	std::vector<std::vector<std::pair<int, int>>> neighbors;
+	std::vector<std::vector<std::pair<int, double>>> handover;	// (tile, share of UEs) per tile; empty = none
+};
+
+// counters collected for every base station
+struct tileStats
+{
+	long long arrivals = 0;	// packets generated by the tile's UEs
+	long long served = 0;	// packets transmitted by the tile's antennas
+	long long dropped = 0;	// packets lost to a full antenna buffer
+	long long blocked = 0;	// packets generated while the tile was down
+	double delaySum = 0;	// total queueing + service + air delay of served packets
+};
+
+// alt congested tiles (state 2) leave their second set of UEs quiet in every
+// other period of ALT_PERIOD seconds, on a clock shared by all tiles
+static const double ALT_PERIOD = 900.0;
+
+inline bool altQuiet(double now)
+{
+	return ((long long)(now / ALT_PERIOD) & 1) != 0;
+}
+
+// event types handled by the engine
+enum simEventType
+{
+	EVENT_ARRIVAL,	// a UE generates a packet; target = UE
+	EVENT_DEPARTURE	// an antenna transceiver finishes a packet; target = antenna
+};
+
+// pooled event object; stamp is the arrival time of the packet in service
+struct simEvent
+{
+	int type;
+	int target;
+	double stamp;
+};
+
+// scheduler entry; four siblings fill exactly one 64 byte cache line
+struct heapEntry
+{
+	double time;
+	int event;
+};
+
+// one block of memory holding every array of a run; carved front to back at
+// the start of a run and dropped as a whole at the start of the next, so an
+// engine reused from run to run only allocates when a run is bigger than all
+// runs before it
+struct simArena
+{
+	char* base = NULL;
+	size_t capacity = 0;
+	size_t used = 0;
+	simArena() {}
+	simArena(const simArena&) = delete;
+	simArena& operator=(const simArena&) = delete;
+	~simArena() { free(base); }
+};
+
+// array of plain values carved from a simArena; it never grows, size() only
+// moves within the capacity it was carved with
+template <class T>
+struct arenaArray
+{
+	T* items = NULL;
+	size_t count = 0;
+	size_t capacity = 0;
+
+	size_t size() const { return count; }
+	bool empty() const { return count == 0; }
+	T* data() { return items; }
+	const T* data() const { return items; }
+	T* begin() { return items; }
+	T* end() { return items + count; }
+	const T* begin() const { return items; }
+	const T* end() const { return items + count; }
+	T& operator[](size_t i) { return items[i]; }
+	const T& operator[](size_t i) const { return items[i]; }
+	T& back() { return items[count - 1]; }
+	void push_back(const T& x) { items[count++] = x; }
+	void pop_back() { count--; }
+	void assign(size_t n, const T& x)
+	{
+		for (size_t i = 0; i < n; i++)
+			items[i] = x;
+		count = n;
+	}
+	void resize(size_t n)
+	{
+		for (size_t i = count; i < n; i++)
+			items[i] = T();
+		count = n;
+	}
+};
+
+// bytes an array of n T takes in an arena; every array starts on a cache line
+template <class T>
+inline size_t arenaBytes(size_t n)
+{
+	return (n * sizeof(T) + 63) / 64 * 64;
+}
+
+// drop everything carved from the arena and make sure it holds "bytes"
+void arenaReset(simArena& arena, size_t bytes);
+
+// the next "bytes" of the arena (a multiple of 64); running out is a bug in
+// the sizing of the caller and aborts
+void* arenaTake(simArena& arena, size_t bytes);
+
+template <class T>
+inline void arenaCarve(simArena& arena, arenaArray<T>& array, size_t capacity)
+{
+	array.items = (T*)arenaTake(arena, arenaBytes<T>(capacity));
+	array.count = 0;
+	array.capacity = capacity;
+}
+
+// complete state of a run; tiles own antNum antennas, antennas own UEs.
+// Tiles, antennas and UEs are numbered within the engine: an engine running
+// every tile numbers them as the topology does, one running only some tiles
+// (see initSimulation()) holds just those, their antennas and the UEs they serve
+struct simEngine
+{
+	simParams params;
+	double now = 0;
+	long long events = 0;
+	double wallSeconds = 0;
+	long long allocations = 0;	// heap allocations made by stepSimulation() this run, as threadAllocations() counts them
+
+	// everything below is carved from the arena by initSimulation(), sized for
+	// the most the run can ever hold
+	simArena arena;
+
+	// 4-ary min heap of pending events; the root lives at index 3 so that
+	// every group of siblings starts on a cache line boundary
+	arenaArray<heapEntry> heap;
+	arenaArray<simEvent> pool;
+	arenaArray<int> freeEvents;
+
+	// per tile
+	arenaArray<int> tileId;	// number of the tile in the topology
+	arenaArray<int> tileState;
+	arenaArray<tileStats> stats;
+	arenaArray<rngStream> tileRng;	// RNG_TRAFFIC stream of every tile
+
+	// per antenna, antNum per tile in tile order; antenna a buffers its waiting
+	// packets (their arrival times) in antSlots[a * bufferStride(bufSize) ...]
+	arenaArray<int> antTile;
+	arenaArray<int> antBusy;
+	arenaArray<packetBuffer> antBuffer;
+	arenaArray<double> antSlots;
+	int slotShift = 0;	// log2 of the stride of antSlots
+	int slotMask = 0;
+
+	// per UE
+	arenaArray<int> ueAntenna;
+	arenaArray<double> ueRate;
+	arenaArray<char> ueAlt;	// extra UE of an alt congested tile, silent while altQuiet(); kept after a handover
+
+	int serversPerAntenna = 1;
+	double meanService = 0, airDelay = 0;
+};
+
+// build the UE/antenna model for a topology and schedule the first events.
+// With "owned" given, the engine only holds and runs the tiles it marks, their
+// antennas and the UEs they serve (see SHNSim_Regions.h); those draw the same
+// random numbers either way
+void initSimulation(simEngine& eng, const simTopology& topo, const simParams& params, unsigned long long seed, const std::vector<char>* owned = NULL);
+
+// process events up to (and including) simulated time "until"; returns false once the run is over
+bool stepSimulation(simEngine& eng, double until);
+
+// slots of antenna a's buffer
+inline double* antennaSlots(simEngine& eng, int a)
+{
+	return eng.antSlots.data() + ((size_t)a << eng.slotShift);
+}
+inline const double* antennaSlots(const simEngine& eng, int a)
+{
+	return eng.antSlots.data() + ((size_t)a << eng.slotShift);
+}
+
+// run a whole simulation from start to params.simLen
+void runSimulation(simEngine& eng, const simTopology& topo, const simParams& params, unsigned long long seed);
+
+// heap allocations made by the calling thread so far: arena growth, and every
+// operator new in programs linking SHNSim_Allocations.cpp (the bench)
+void countAllocation();
+long long threadAllocations();
+
+// 64 bit hash of "size" bytes, chained through h; used to recognize a model
+// (checkpoints) or a run (sweep result cache), not for security
+uint64_t hashBytes(uint64_t h, const void* data, size_t size);
+
+#endif
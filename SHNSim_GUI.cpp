@@ -1,3 +1,5 @@
+// build: g++ -O2 -pthread SHNSim_GUI.cpp SHNSim_Layout.cpp SHNSim_Engine.cpp SHNSim_Batch.cpp SHNSim_Results.cpp SHNSim_Healing.cpp SHNSim_Trace.cpp SHNSim_Generate.cpp SHNSim_Checkpoint.cpp SHNSim_Sweep.cpp SHNSim_Random.cpp SHNSim_Regions.cpp `pkg-config --cflags --libs gtk+-3.0`
+
 #include <iostream>
 #include <gtk/gtk.h>
 #include <cairo.h>
@@ -7,6 +9,16 @@
 #include <gdk/gdkkeysyms.h>
 #include <vector>
 #include <utility>
+#include <unordered_map>
+#include <algorithm>
+#include <thread>
+#include "SHNSim_Engine.h"
+#include "SHNSim_Batch.h"
+#include "SHNSim_Layout.h"
+#include "SHNSim_Healing.h"
+#include "SHNSim_Trace.h"
+#include "SHNSim_Generate.h"
+#include "SHNSim_Sweep.h"
 
 using namespace std;
 
@@ -16,6 +28,7 @@ struct
 	GtkWidget* DrawingWindow;
 	GtkWidget* SimParamWindow;
 	GtkWidget* DiagnosticsWindow;
+	GtkWidget* DrawingArea;
 	
 } WINDOWS;
 
@@ -33,17 +46,46 @@ struct coord
 	double y;
 };
 
+// corners of a hexagon with unit side length, (sin, cos) of 2 * PI / 6 * (0.5 + k);
+// drawn side k runs from corner k - 1 to corner k (0 = bottom, then clockwise
+// on screen: 1 = bottom right ... 5 = bottom left)
+static const double hexCorner[6][2] = {{0.5, 0.86602540378443865}, {1, 0}, {0.5, -0.86602540378443865}, {-0.5, -0.86602540378443865}, {-1, 0}, {-0.5, 0.86602540378443865}};
+
+// axial offset of the neighbor across each drawn side
+static const int sideDir[6][2] = {{0, 1}, {1, 0}, {1, -1}, {0, -1}, {-1, 0}, {-1, 1}};
+
+// define structure returned by the hit test: the lattice cell under a point,
+// the tile in that cell (-1 if empty) and the side of the selected tile facing it
+struct hexHit
+{
+	int q, r;
+	int tile;
+	int side;
+};
+
 // define structure that represents the list of nodes (hexagons) in the system
 // as well as other parameters needed to run the simulation
 struct
 {
 	int count, selectedTile, highlightedSide;
 	double sideLength, screenWidth, screenHeight, mouseX, mouseY;
- 	vector<pair<int, int>> neighbors[1000];
- 	vector<vector<double>> coords;
+ 	vector<vector<pair<int, int>>> neighbors;	// (tile, side) pairs
+ 	vector<pair<int, int>> axial;	// integer (q,r) lattice position of each tile
+ 	unordered_map<long long, int> hexIndex;	// packed (q,r) -> tile index
+ 	vector<bool> cutTile;	// true if removing the tile would split the network
+ 	bool topologyStale = true;	// neighbors and cutTile need rebuilding
+ 	healPlan heal;	// self-healing handovers of the network as drawn
+ 	bool healStale = true;	// heal needs a full rebuild (layout or parameters changed)
  	vector<int> state;	// 0 = healthy, 1 = congested, 2 = alt congested, 3 = down
  	vector<int> path;
  	
+ 	// view transform: a tile's pixel center is (viewX, viewY) plus sideLength
+ 	// times its lattice position (1.5 * q, sqrt(3) * (r + q / 2))
+ 	double viewX, viewY;
+ 	bool autoFit = true;	// refit the view after every edit until the user zooms or pans
+ 	int minQ, maxQ, minY2, maxY2;	// lattice bounding box; Y2 = 2 * r + q
+ 	long long clickTime = -1;	// traceNow() of the last click not yet repainted
+ 	
 	// stage 2 parameters
 	int bsLen = 5;
 	int antNum = 3;
@@ -56,18 +98,136 @@ struct
 	int simStartNum = 0;
 	string simName = "default name";
 	int bufSize = 10;
+	int selfHealing = 0;
+	double seriesInterval = 0;	// seconds between time series samples, 0 = off
+	bool seriesCsv = false;
+	double checkpointInterval = 0;	// seconds between run snapshots, 0 = off
+	int regions = 1;	// threads sharing every run
+	vector<pair<string, string>> sweep;	// (parameter, values) of entries holding a list or range
 	
 } glob;
 
+// define structure that holds the cached drawing of the grid without the
+// selected tile; rebuilt only when tiles are added, deleted, scaled or change state
+struct
+{
+	cairo_surface_t* surface = NULL;
+	bool stale = true;
+	vector<int> visible;	// tiles in view at the last rebuild
+	vector<int> byColor;	// the same tiles sorted by fill color
+	cairo_surface_t* cells = NULL;	// one pixel per cell when the grid is drawn as cells
+	vector<signed char> cellColor;	// most severe fill in every cell, -1 = empty
+	
+} gridLayer;
+
+// define structure that holds the shaped glyphs of the digits at the label size
+// of the current side length, and the glyph runs of the labels being drawn;
+// the digits are shaped again only when glob.sideLength changes
+struct
+{
+	double sideLength = -1;	// side length the digits were shaped for, -1 = none yet
+	unsigned long digit[10];	// glyph of every digit
+	double advance[10];	// and its width
+	vector<cairo_glyph_t> indices, states;	// white tile indices and blue states
+	
+} labelGlyphs;
+
+// define structure that holds the live heatmap of a run: the fill of every tile
+// follows its latest sample. Samples taken from the rings only mark their tiles;
+// once per frame of the drawing area the marked tiles get their new fill, and
+// only tiles whose fill changed are repainted into the grid layer
+struct
+{
+	bool on = false;	// fills come from the heatmap; off again after an edit
+	int metric = 0;	// heatMetric shown
+	vector<signed char> color;	// fill of every tile (see tileColor()), -1 = no sample yet
+	vector<int> lastRun;	// sample the load of every tile is measured from
+	vector<double> lastTime;
+	vector<long long> lastServed;
+	vector<double> load;	// served per second between the two latest samples, -1 = not known yet
+	vector<int> pending;	// tiles with a sample not yet shown
+	vector<char> isPending;
+	guint tick = 0;	// frame clock callback, 0 = none
+	
+} heatmap;
+
 // define a struct to hold references to entry boxes (used to pass
 // entry from the text boxes throughout the entire program)
 struct
 {
 	GtkWidget *baseStationSide, *antennaNumber, *transceiverNum, *transceiverDist, *maxDataRate, *userEquipPerAntenna;
 	GtkWidget *simulationLength, *simulationNumber, *simulationStart, *simulationSaveName, *bufferSize; 
+	GtkWidget *seriesInterval, *seriesCsv, *selfHealing, *checkpointInterval, *regions;
 	
 } entryBoxes;
 
+// define a struct to hold the labels of the diagnostics window
+struct
+{
+	GtkWidget *runs, *simTime, *packets, *throughput, *tiles, *counters;
+	
+} diagLabels;
+
+// define structure that holds the simulation batch running in the background;
+// the worker thread only ever talks to the GUI through "progress"
+struct
+{
+	thread worker;
+	batchProgress progress;
+	vector<runSummary> runs;	// written by the worker before progress.finished
+	vector<sweepResult> sweepRuns;	// same, for a sweep
+	vector<simParams> points;	// points of the sweep, empty for a plain batch
+	vector<tileSample> latest;	// newest sample of every tile
+	int runCount;
+	long long lastEvents;
+	gint64 lastTick;
+	bool running = false;
+	
+} simJob;
+
+// diagnostics refresh rate and the most samples taken from the rings per refresh
+static const int DIAG_REFRESH_MS = 100;
+static const int DIAG_MAX_SAMPLES = 50000;
+
+// refresh rate of the trace counters in the diagnostics window and the file
+// a trace is written to when tracing is switched off (Ctrl+T)
+static const int TRACE_REFRESH_MS = 500;
+static const char* TRACE_FILE = "shnsim_trace.json";
+
+// level of detail of the grid, by the side of a tile in pixels: smaller tiles
+// lose their labels (and are filled by state instead), then their borders and
+// handovers, and are finally drawn as CELL_PIXELS squares colored by the most
+// severe state among the tiles overlapping each square
+static const double LABEL_MIN_SIDE = 12.0;
+static const double BORDER_MIN_SIDE = 4.0;
+static const double CELL_MIN_SIDE = 1.5;
+static const int CELL_PIXELS = 2;
+
+// fill of each state where the state labels are not drawn, and the order of
+// severity of the states (healthy, alt congested, congested, down)
+static const double stateColor[4][3] = {{0, 200.0/255.0, 0}, {1, 0.55, 0}, {0.9, 0.85, 0}, {0.45, 0.45, 0.45}};
+static const int stateSeverity[4] = {0, 2, 1, 3};
+
+// metrics of the live heatmap (cycled with M); load and buffer occupancy are
+// shown in HEAT_BUCKETS colors from green (idle) to red (at capacity), state
+// in the state colors, with alt congested tiles green while they are quiet
+enum heatMetric
+{
+	HEAT_LOAD,	// packets served per second against what the tile's antennas carry
+	HEAT_BUFFER,	// packets queued against the room in the tile's buffers
+	HEAT_STATE,
+	HEAT_METRICS
+};
+static const char* const HEAT_NAMES[HEAT_METRICS] = {"load", "buffer occupancy", "state"};
+static const int HEAT_BUCKETS = 8;
+
+// fills a tile can have: the four states, then the heat buckets
+static const int TILE_COLORS = 4 + HEAT_BUCKETS;
+
+// limits of zooming, as the side of a tile in pixels
+static const double MIN_SIDE = 0.1;
+static const double MAX_SIDE = 400.0;
+
 // window setup function prototypes
 void setUpDrawingWindow();
 void setUpSimParamWindow();
@@ -76,19 +236,49 @@ void setUpDiagnosticsWindow();
 // navigation function prototypes - used to change windows
 void goToSimParams();
 void runSim();
+void stopSim();
 void backToDrawingStage();
 
 // functions used in drawing window
-static void getScreenHeight();
 static void drawHex(cairo_t *);
+static void drawGridLayer(cairo_t *);
+static void drawCells(cairo_t *);
+static void drawHandovers(cairo_t *, int tile);
+static void findVisibleTiles(double margin);
+static int tileColor(int tile);
+static void tileRgb(int color, double rgb[3]);
+static void setTileColor(cairo_t *, int color);
+static int colorSeverity(int color);
+static void drawTile(cairo_t *, int tile, bool selected);
+static void addLabels(cairo_t *, int tile);
+static void showLabelText(cairo_t *, int tile);
+static void showLabels(cairo_t *);
+static int pointerSide(double x, double y);
+static hexHit hitTest(double x, double y);
+static coord tileCenter(int tile);
+
+// functions used to fit, zoom and pan the view of the grid
+static void growBounds(int q, int r);
+static void computeBounds();
+static void fitView();
+static void zoomView(double factor, double x, double y);
+static void panView(double dx, double dy);
+static gboolean mouse_scrolled(GtkWidget *widget, GdkEventScroll *event, gpointer user_data);
+static gboolean key_pressed(GtkWidget *widget, GdkEventKey *event, gpointer user_data);
+static void queueSideDraw(GtkWidget *widget, int tile, int sideA, int sideB);
 static void button_clicked(GtkWidget* widget, gpointer data);
 static gboolean mouse_moved(GtkWidget *widget, GdkEvent *event, gpointer user_data);
 static gboolean mouse_clicked(GtkWidget *widget, GdkEventButton *event, gpointer user_data);
 static gboolean on_draw_event(GtkWidget *widget, cairo_t *cr, gpointer user_data);
-static float distance(double x1, double y1, double x2, double y2);
-static int side(double x1, double y1, double x2, double y2);
 static bool deletionValid(int tile);
 static void getNeighbors();
+static void findCutTiles();
+static void updateConnectivity();
+static void updateHealing();
+
+// functions used to maintain the axial tile index
+static int findTile(int q, int r);
+static void indexTiles();
 
 // Utility function(s)
 void getDimensions();
@@ -96,6 +286,35 @@ void getDimensions();
 // function to add parameters to param struct; used to pass params to run the simulation
 void addParams();
 
+// functions used to run the simulation in the background and report its progress
+static void batchThread(simTopology topo, simParams params, string simName, int firstRun, int runs, int threads, resultsOptions series);
+static void sweepThread(simTopology topo, vector<simParams> points, string simName, int firstRun, int runs, int threads);
+static gboolean diagnostics_tick(gpointer user_data);
+static void startHeatmap();
+static void measureLoad(int tile);
+static int heatColor(int tile);
+static gboolean heatmap_tick(GtkWidget *widget, GdkFrameClock *clock, gpointer user_data);
+static gboolean counters_tick(gpointer user_data);
+static void toggleTracing();
+static void printRuns();
+
+// functions to copy the network and parameters out of glob for the simulation engine
+simTopology getSimTopology();
+simParams getSimParams();
+
+// functions to save the network to and open it from a layout file
+static void saveLayoutFile();
+static void openLayoutFile();
+static void generateGrid();
+static void useLayout(const simLayout& layout);
+static simLayout getSimLayout();
+static simSettings getSimSettings();
+static GtkWidget* sweepEntry(const string& name);
+static void setSimSettings(const simSettings& settings);
+static string chooseFile(bool save);
+
+// SHNSim_Bench.cpp compiles this file with its own main()
+#ifndef SHNSIM_BENCH
 int main(int argc, char** argv)
 {
 	// initialize gtk	
@@ -107,13 +326,18 @@ int main(int argc, char** argv)
 	// set up all windows
 	setUpDrawingWindow();
 	setUpSimParamWindow();
+	setUpDiagnosticsWindow();
 	
 	// initialize the system by making the first window visible
 	gtk_widget_show_all(WINDOWS.DrawingWindow);
 	
 	gtk_main();
+	
+	// don't leave a simulation thread running behind the closed windows
+	stopSim();
 	return 0;
 }
+#endif
 
 void setUpDrawingWindow()
 {
@@ -132,6 +356,7 @@ void setUpDrawingWindow()
 	WINDOWS.DrawingWindow = window;
 
   	darea = gtk_drawing_area_new();
+	WINDOWS.DrawingArea = darea;
   	button = gtk_button_new_with_label("Next Page");
 	fixed = gtk_fixed_new();
   
@@ -140,9 +365,12 @@ void setUpDrawingWindow()
   	g_signal_connect(window, "destroy", G_CALLBACK(gtk_main_quit), NULL);  
   	g_signal_connect(window, "button-press-event", G_CALLBACK(mouse_clicked), NULL);
 	g_signal_connect (window, "motion-notify-event", G_CALLBACK (mouse_moved), NULL);
+	g_signal_connect(window, "scroll-event", G_CALLBACK(mouse_scrolled), NULL);
+	g_signal_connect(window, "key-press-event", G_CALLBACK(key_pressed), NULL);
  	
  	gtk_widget_add_events(window, GDK_BUTTON_PRESS_MASK);
  	gtk_widget_set_events(window, GDK_POINTER_MOTION_MASK);
+ 	gtk_widget_add_events(window, GDK_SCROLL_MASK | GDK_BUTTON2_MASK | GDK_KEY_PRESS_MASK);
   	gtk_window_set_position(GTK_WINDOW(window), GTK_WIN_POS_CENTER);
 	gtk_window_set_default_size(GTK_WINDOW(window), glob.screenWidth, glob.screenHeight); 
   
@@ -175,8 +403,9 @@ void setUpSimParamWindow()
 	GtkWidget *bsSideTxt, *numAntennaTxt, *numTransceiversTxt, *distTransceiversTxt, *maxDRTxt, *uePerAntennaTxt; // textbox
 	
 	// create input labels and text boxes from stage 3 of C# code
-	GtkWidget *simLength, *simNum, *simStart, *simSaveName, *bufSize; // labels
-	GtkWidget *simLengthTxt, *simNumTxt, *simStartTxt, *simSaveNameTxt, *bufSizeTxt; // textboxes
+	GtkWidget *simLength, *simNum, *simStart, *simSaveName, *bufSize, *seriesInterval, *checkpointInterval, *regions; // labels
+	GtkWidget *simLengthTxt, *simNumTxt, *simStartTxt, *simSaveNameTxt, *bufSizeTxt, *seriesIntervalTxt, *checkpointIntervalTxt, *regionsTxt; // textboxes
+	GtkWidget *seriesCsvBtn, *selfHealingBtn; // check boxes
 	
 	// create back button and run simulation button
 	GtkWidget *backToS1Btn, *runSimBtn;
@@ -194,6 +423,7 @@ void setUpSimParamWindow()
 	maxDRTxt = gtk_entry_new();
 	uePerAntenna = gtk_label_new("Enter UEs per Antenna [normal BS] (1 < n < 40)");
 	uePerAntennaTxt = gtk_entry_new();
+	selfHealingBtn = gtk_check_button_new_with_label("Self-Healing (hand UEs of down and congested BSs to neighbors)");
 	
 	simLength = gtk_label_new("Length of Simulation (seconds)");
 	simLengthTxt = gtk_entry_new();
@@ -205,6 +435,13 @@ void setUpSimParamWindow()
 	simSaveNameTxt = gtk_entry_new();
 	bufSize = gtk_label_new("Buffer size");
 	bufSizeTxt = gtk_entry_new();
+	seriesInterval = gtk_label_new("Time Series Interval (seconds, 0 = off)");
+	seriesIntervalTxt = gtk_entry_new();
+	seriesCsvBtn = gtk_check_button_new_with_label("Write Time Series as CSV");
+	checkpointInterval = gtk_label_new("Snapshot Interval for Resuming Runs (seconds, 0 = off)");
+	checkpointIntervalTxt = gtk_entry_new();
+	regions = gtk_label_new("Regions per Run (threads sharing one run)");
+	regionsTxt = gtk_entry_new();
 	
 	backToS1Btn = gtk_button_new_with_label("Back");
 	runSimBtn = gtk_button_new_with_label("Run Simulation");
@@ -234,6 +471,7 @@ void setUpSimParamWindow()
 	gtk_box_pack_start(GTK_BOX(bsInputs), maxDRTxt, 0, 0, 0);
 	gtk_box_pack_start(GTK_BOX(bsInputs), uePerAntenna, 0, 0, 15);
 	gtk_box_pack_start(GTK_BOX(bsInputs), uePerAntennaTxt, 0, 0, 0);
+	gtk_box_pack_start(GTK_BOX(bsInputs), selfHealingBtn, 0, 0, 15);
 	gtk_box_pack_end(GTK_BOX(bsInputs), backToS1Btn, 0, 0, 30);
 	
 	// pack bs input labels and textboxes into sim inputs container
@@ -247,6 +485,13 @@ void setUpSimParamWindow()
 	gtk_box_pack_start(GTK_BOX(simInputs), simSaveNameTxt, 0, 0, 0);
 	gtk_box_pack_start(GTK_BOX(simInputs), bufSize, 0, 0, 15);
 	gtk_box_pack_start(GTK_BOX(simInputs), bufSizeTxt, 0, 0, 0);
+	gtk_box_pack_start(GTK_BOX(simInputs), seriesInterval, 0, 0, 15);
+	gtk_box_pack_start(GTK_BOX(simInputs), seriesIntervalTxt, 0, 0, 0);
+	gtk_box_pack_start(GTK_BOX(simInputs), seriesCsvBtn, 0, 0, 15);
+	gtk_box_pack_start(GTK_BOX(simInputs), checkpointInterval, 0, 0, 15);
+	gtk_box_pack_start(GTK_BOX(simInputs), checkpointIntervalTxt, 0, 0, 0);
+	gtk_box_pack_start(GTK_BOX(simInputs), regions, 0, 0, 15);
+	gtk_box_pack_start(GTK_BOX(simInputs), regionsTxt, 0, 0, 0);
 	gtk_box_pack_end(GTK_BOX(simInputs), runSimBtn, 0, 0, 30);
 	
 	// pack bs inputs and sim inputs into 2 column container
@@ -274,6 +519,11 @@ void setUpSimParamWindow()
 	entryBoxes.simulationStart = simStartTxt;
 	entryBoxes.simulationSaveName = simSaveNameTxt;
 	entryBoxes.bufferSize = bufSizeTxt;
+	entryBoxes.seriesInterval = seriesIntervalTxt;
+	entryBoxes.seriesCsv = seriesCsvBtn;
+	entryBoxes.selfHealing = selfHealingBtn;
+	entryBoxes.checkpointInterval = checkpointIntervalTxt;
+	entryBoxes.regions = regionsTxt;
 	
 	// load color settings for the GUI from CSS file
 	GtkCssProvider* guiProvider = gtk_css_provider_new();
@@ -291,6 +541,11 @@ void setUpSimParamWindow()
 		gtk_style_context_add_provider(gtk_widget_get_style_context(simStart), GTK_STYLE_PROVIDER(guiProvider), GTK_STYLE_PROVIDER_PRIORITY_USER);
 		gtk_style_context_add_provider(gtk_widget_get_style_context(simSaveName), GTK_STYLE_PROVIDER(guiProvider), GTK_STYLE_PROVIDER_PRIORITY_USER);
 		gtk_style_context_add_provider(gtk_widget_get_style_context(bufSize), GTK_STYLE_PROVIDER(guiProvider), GTK_STYLE_PROVIDER_PRIORITY_USER);
+		gtk_style_context_add_provider(gtk_widget_get_style_context(seriesInterval), GTK_STYLE_PROVIDER(guiProvider), GTK_STYLE_PROVIDER_PRIORITY_USER);
+		gtk_style_context_add_provider(gtk_widget_get_style_context(seriesCsvBtn), GTK_STYLE_PROVIDER(guiProvider), GTK_STYLE_PROVIDER_PRIORITY_USER);
+		gtk_style_context_add_provider(gtk_widget_get_style_context(selfHealingBtn), GTK_STYLE_PROVIDER(guiProvider), GTK_STYLE_PROVIDER_PRIORITY_USER);
+		gtk_style_context_add_provider(gtk_widget_get_style_context(checkpointInterval), GTK_STYLE_PROVIDER(guiProvider), GTK_STYLE_PROVIDER_PRIORITY_USER);
+		gtk_style_context_add_provider(gtk_widget_get_style_context(regions), GTK_STYLE_PROVIDER(guiProvider), GTK_STYLE_PROVIDER_PRIORITY_USER);
 
 		// buttons		
 		gtk_style_context_add_provider(gtk_widget_get_style_context(backToS1Btn), GTK_STYLE_PROVIDER(guiProvider), GTK_STYLE_PROVIDER_PRIORITY_USER);
@@ -308,6 +563,9 @@ void setUpSimParamWindow()
 		gtk_style_context_add_provider(gtk_widget_get_style_context(simStartTxt), GTK_STYLE_PROVIDER(guiProvider), GTK_STYLE_PROVIDER_PRIORITY_USER);
 		gtk_style_context_add_provider(gtk_widget_get_style_context(simSaveNameTxt), GTK_STYLE_PROVIDER(guiProvider), GTK_STYLE_PROVIDER_PRIORITY_USER);
 		gtk_style_context_add_provider(gtk_widget_get_style_context(bufSizeTxt), GTK_STYLE_PROVIDER(guiProvider), GTK_STYLE_PROVIDER_PRIORITY_USER);
+		gtk_style_context_add_provider(gtk_widget_get_style_context(seriesIntervalTxt), GTK_STYLE_PROVIDER(guiProvider), GTK_STYLE_PROVIDER_PRIORITY_USER);
+		gtk_style_context_add_provider(gtk_widget_get_style_context(checkpointIntervalTxt), GTK_STYLE_PROVIDER(guiProvider), GTK_STYLE_PROVIDER_PRIORITY_USER);
+		gtk_style_context_add_provider(gtk_widget_get_style_context(regionsTxt), GTK_STYLE_PROVIDER(guiProvider), GTK_STYLE_PROVIDER_PRIORITY_USER);
 
 		// title
 		gtk_style_context_add_provider(gtk_widget_get_style_context(title), GTK_STYLE_PROVIDER(guiProvider), GTK_STYLE_PROVIDER_PRIORITY_USER);
@@ -316,7 +574,38 @@ void setUpSimParamWindow()
 
 void setUpDiagnosticsWindow()
 {
-	// TODO - Will contain information about the system during runtime.
+	// window showing the state of the simulation while it runs
+	GtkWidget* window = gtk_window_new(GTK_WINDOW_TOPLEVEL);
+	gtk_window_set_title(GTK_WINDOW(window), "Diagnostics");
+	gtk_window_set_default_size(GTK_WINDOW(window), SCREEN.WIDTH / 3, SCREEN.HEIGHT / 2);
+	g_signal_connect(window, "delete-event", G_CALLBACK(gtk_widget_hide_on_delete), NULL);
+	
+	WINDOWS.DiagnosticsWindow = window;
+	
+	GtkWidget* title = gtk_label_new("Simulation Diagnostics");
+	gtk_widget_set_name(title, "title");
+	
+	diagLabels.runs = gtk_label_new("");
+	diagLabels.simTime = gtk_label_new("");
+	diagLabels.packets = gtk_label_new("");
+	diagLabels.throughput = gtk_label_new("");
+	diagLabels.tiles = gtk_label_new("");
+	gtk_label_set_justify(GTK_LABEL(diagLabels.tiles), GTK_JUSTIFY_LEFT);
+	diagLabels.counters = gtk_label_new("");
+	gtk_label_set_justify(GTK_LABEL(diagLabels.counters), GTK_JUSTIFY_LEFT);
+	
+	GtkWidget* mainBox = gtk_box_new(GTK_ORIENTATION_VERTICAL, 0);
+	gtk_box_pack_start(GTK_BOX(mainBox), title, 0, 1, 10);
+	gtk_box_pack_start(GTK_BOX(mainBox), diagLabels.runs, 0, 0, 5);
+	gtk_box_pack_start(GTK_BOX(mainBox), diagLabels.simTime, 0, 0, 5);
+	gtk_box_pack_start(GTK_BOX(mainBox), diagLabels.packets, 0, 0, 5);
+	gtk_box_pack_start(GTK_BOX(mainBox), diagLabels.throughput, 0, 0, 5);
+	gtk_box_pack_start(GTK_BOX(mainBox), diagLabels.tiles, 1, 1, 10);
+	gtk_box_pack_start(GTK_BOX(mainBox), diagLabels.counters, 0, 0, 10);
+	gtk_container_add(GTK_CONTAINER(window), mainBox);
+	
+	// the trace counters are refreshed even when no simulation is running
+	g_timeout_add(TRACE_REFRESH_MS, counters_tick, NULL);
 }
 
 void goToSimParams()
@@ -325,17 +614,354 @@ void goToSimParams()
 	gtk_widget_hide_on_delete(WINDOWS.DrawingWindow);
 }
 
-// NOTE: does NOT open another window after running simulation (yet)
 void runSim()
 {
+	if (simJob.running)
+	{
+		printf("A simulation is already running\n");
+		return;
+	}
+	
 	// call a function to add values from entry boxes to parameter struct
 	addParams();
+	vector<sweepAxis> axes;
+	if (!sweepAxes(glob.sweep, axes))
+		return;
+	if (!axes.empty() && !checkSweepOptions(getSimSettings().series))
+		return;
 	
-	//gtk_widget_show_all(WINDOWS.DiagnosticsWindow);
+	// the drawing window stays up next to the diagnostics to show the heatmap
+	gtk_widget_show_all(WINDOWS.DiagnosticsWindow);
+	gtk_widget_show_all(WINDOWS.DrawingWindow);
 	gtk_widget_hide_on_delete(WINDOWS.SimParamWindow);
 	
 	cout << "running..." << endl;
 	
+	// replications simStartNum .. simStartNum + simNum - 1 run on a background
+	// thread; the GUI polls their progress at a fixed rate
+	int threads = batchThreads(0, glob.simNum, glob.regions);
+	resetProgress(simJob.progress, threads, 1 << 16);
+	simJob.progress.interval = max(1.0, glob.simLen / 200.0);
+	simJob.latest.assign(glob.count, tileSample());
+	for (int i = 0; i < glob.count; i++)
+	{
+		simJob.latest[i].run = -1;
+	}
+	startHeatmap();
+	simJob.runCount = max(0, glob.simNum);
+	simJob.lastEvents = 0;
+	simJob.lastTick = g_get_monotonic_time();
+	simJob.running = true;
+	simJob.points.clear();
+	if (!axes.empty())
+	{
+		// every point of the sweep heals the network for its own parameters
+		updateConnectivity();
+		simTopology topo;
+		topo.state = glob.state;
+		topo.neighbors = glob.neighbors;
+		simJob.points = sweepPoints(getSimParams(), axes);
+		simJob.runCount *= (int)simJob.points.size();
+		simJob.worker = thread(sweepThread, topo, simJob.points, glob.simName, glob.simStartNum, glob.simNum, batchThreads(0, simJob.runCount));
+	}
+	else
+	{
+		simJob.worker = thread(batchThread, getSimTopology(), getSimParams(), glob.simName, glob.simStartNum, glob.simNum, threads, getSimSettings().series);
+	}
+	g_timeout_add(DIAG_REFRESH_MS, diagnostics_tick, NULL);
+}
+
+void stopSim()
+{
+	if (!simJob.running)
+		return;
+	simJob.progress.cancel = true;
+	simJob.worker.join();
+	simJob.running = false;
+}
+
+static void batchThread(simTopology topo, simParams params, string simName, int firstRun, int runs, int threads, resultsOptions series)
+{
+	simJob.runs = runBatch(topo, params, simName, firstRun, runs, threads, &simJob.progress, series);
+	simJob.progress.finished.store(true, memory_order_release);
+}
+
+static void sweepThread(simTopology topo, vector<simParams> points, string simName, int firstRun, int runs, int threads)
+{
+	simJob.sweepRuns = runSweep(topo, points, simName, firstRun, runs, threads, SWEEP_CACHE_DIR, &simJob.progress);
+	simJob.progress.finished.store(true, memory_order_release);
+}
+
+static gboolean diagnostics_tick(gpointer user_data)
+{
+	if (!simJob.running)
+		return FALSE;
+	bool finished = simJob.progress.finished.load(memory_order_acquire);
+	
+	// take at most DIAG_MAX_SAMPLES per refresh; whatever is left waits for the next one
+	int taken = 0;
+	tileSample sample;
+	for (int r = 0; r < (int)simJob.progress.rings.size(); r++)
+	{
+		while (taken < DIAG_MAX_SAMPLES && simJob.progress.rings[r]->pop(sample))
+		{
+			taken++;
+			if (sample.tile < (int)simJob.latest.size() && (sample.run > simJob.latest[sample.tile].run || (sample.run == simJob.latest[sample.tile].run && sample.time >= simJob.latest[sample.tile].time)))
+			{
+				simJob.latest[sample.tile] = sample;
+				if (!heatmap.isPending[sample.tile])
+				{
+					heatmap.isPending[sample.tile] = 1;
+					heatmap.pending.push_back(sample.tile);
+				}
+			}
+		}
+	}
+	
+	long long generated = 0, served = 0, dropped = 0, blocked = 0;
+	double simTime = 0;
+	int run = -1;
+	for (int i = 0; i < (int)simJob.latest.size(); i++)
+	{
+		generated += simJob.latest[i].arrivals;
+		served += simJob.latest[i].served;
+		dropped += simJob.latest[i].dropped;
+		blocked += simJob.latest[i].blocked;
+		if (simJob.latest[i].run > run || (simJob.latest[i].run == run && simJob.latest[i].time > simTime))
+		{
+			run = simJob.latest[i].run;
+			simTime = simJob.latest[i].time;
+		}
+	}
+	
+	// tiles with the most dropped and queued packets
+	vector<int> order(simJob.latest.size());
+	for (int i = 0; i < (int)order.size(); i++)
+	{
+		order[i] = i;
+	}
+	int shown = min(10, (int)order.size());
+	partial_sort(order.begin(), order.begin() + shown, order.end(), [](int a, int b)
+	{
+		const tileSample& x = simJob.latest[a];
+		const tileSample& y = simJob.latest[b];
+		return x.dropped + x.queued > y.dropped + y.queued;
+	});
+	
+	long long events = simJob.progress.events.load(memory_order_relaxed);
+	gint64 now = g_get_monotonic_time();
+	double rate = (events - simJob.lastEvents) / max((now - simJob.lastTick) / 1e6, 1e-6);
+	simJob.lastEvents = events;
+	simJob.lastTick = now;
+	TRACE_COUNTER("sim events/s", (long long)rate);
+	
+	char text[256];
+	snprintf(text, sizeof(text), "Runs complete: %i / %i", simJob.progress.runsDone.load(memory_order_relaxed), simJob.runCount);
+	gtk_label_set_text(GTK_LABEL(diagLabels.runs), text);
+	snprintf(text, sizeof(text), "Simulated time (run %i): %.0f / %i s", run, simTime, glob.simLen);
+	gtk_label_set_text(GTK_LABEL(diagLabels.simTime), text);
+	snprintf(text, sizeof(text), "Packets: %lld generated, %lld served, %lld dropped, %lld blocked", generated, served, dropped, blocked);
+	gtk_label_set_text(GTK_LABEL(diagLabels.packets), text);
+	snprintf(text, sizeof(text), "Events: %lld (%.0f events/s), heap allocations in event loops: %lld", events, rate, simJob.progress.allocations.load(memory_order_relaxed));
+	gtk_label_set_text(GTK_LABEL(diagLabels.throughput), text);
+	
+	string tiles = "Busiest base stations:\n";
+	for (int i = 0; i < shown; i++)
+	{
+		const tileSample& t = simJob.latest[order[i]];
+		snprintf(text, sizeof(text), "%i: served %lld, dropped %lld, queued %i\n", order[i], t.served, t.dropped, t.queued);
+		tiles += text;
+	}
+	gtk_label_set_text(GTK_LABEL(diagLabels.tiles), tiles.c_str());
+	
+	if (!finished)
+		return TRUE;
+	
+	simJob.worker.join();
+	simJob.running = false;
+	printRuns();
+	return FALSE;
+}
+
+static void startHeatmap()
+{
+	// every tile keeps its usual fill until its first sample arrives
+	heatmap.on = true;
+	heatmap.color.assign(glob.count, -1);
+	heatmap.lastRun.assign(glob.count, -1);
+	heatmap.lastTime.assign(glob.count, 0);
+	heatmap.lastServed.assign(glob.count, 0);
+	heatmap.load.assign(glob.count, -1);
+	heatmap.pending.clear();
+	heatmap.isPending.assign(glob.count, 0);
+	gridLayer.stale = true;
+	gtk_widget_queue_draw(WINDOWS.DrawingArea);
+	if (heatmap.tick == 0)
+	{
+		heatmap.tick = gtk_widget_add_tick_callback(WINDOWS.DrawingArea, heatmap_tick, NULL, NULL);
+	}
+	printf("Heatmap: %s (M switches between load, buffer occupancy and state)\n", HEAT_NAMES[heatmap.metric]);
+}
+
+// load of a tile from the sample it was last measured from to its latest one;
+// every new sample is measured, whichever metric is shown, and the first sample
+// of a run starts measuring again
+static void measureLoad(int i)
+{
+	const tileSample& sample = simJob.latest[i];
+	if (sample.run < 0)
+		return;
+	bool first = (sample.run != heatmap.lastRun[i] || sample.time <= heatmap.lastTime[i]);
+	heatmap.load[i] = (first ? -1 : (sample.served - heatmap.lastServed[i]) / (sample.time - heatmap.lastTime[i]));
+	heatmap.lastRun[i] = sample.run;
+	heatmap.lastTime[i] = sample.time;
+	heatmap.lastServed[i] = sample.served;
+}
+
+// fill of a tile for the metric shown, from its latest sample and measured
+// load; -1 (its usual fill) while there is no value yet
+static int heatColor(int i)
+{
+	const tileSample& sample = simJob.latest[i];
+	if (sample.run < 0)
+		return -1;
+	if (heatmap.metric == HEAT_STATE)
+	{
+		int state = glob.state[i];
+		return (state == 2 && altQuiet(sample.time) ? 0 : state);
+	}
+	double value;
+	if (heatmap.metric == HEAT_BUFFER)
+	{
+		value = sample.queued / (double)max(1, glob.antNum * glob.bufSize);
+	}
+	else
+	{
+		if (heatmap.load[i] < 0)
+			return -1;
+		value = heatmap.load[i] / max(1.0, (double)glob.antNum * glob.dRateMax * glob.uePerAnt);
+	}
+	return 4 + min(HEAT_BUCKETS - 1, (int)(max(0.0, value) * HEAT_BUCKETS));
+}
+
+static gboolean heatmap_tick(GtkWidget *widget, GdkFrameClock *clock, gpointer user_data)
+{
+	TRACE_SCOPE("heatmap_tick");
+	
+	// tiles whose fill changed are repainted into the cached grid and only
+	// their boxes are queued; a layer that is rebuilt anyway (or drawn as
+	// cells) is simply rebuilt once
+	bool rebuild = (gridLayer.surface == NULL || gridLayer.stale || glob.sideLength < CELL_MIN_SIDE);
+	bool changed = false;
+	long long repainted = 0;
+	cairo_t* layer = NULL;
+	double reach = glob.sideLength + 3.0;
+	for (int j = 0; j < (int)heatmap.pending.size(); j++)
+	{
+		int i = heatmap.pending[j];
+		heatmap.isPending[i] = 0;
+		if (i >= glob.count)
+			continue;
+		measureLoad(i);
+		int color = heatColor(i);
+		if (color == heatmap.color[i])
+			continue;
+		heatmap.color[i] = color;
+		changed = true;
+		coord c = tileCenter(i);
+		if (rebuild || c.x + reach < 0 || c.x - reach > glob.screenWidth || c.y + reach < 0 || c.y - reach > glob.screenHeight)
+			continue;
+		if (layer == NULL)
+		{
+			layer = cairo_create(gridLayer.surface);
+		}
+		drawTile(layer, i, false);
+		gtk_widget_queue_draw_area(widget, (int)floor(c.x - reach), (int)floor(c.y - reach), (int)ceil(2.0 * reach) + 1, (int)ceil(2.0 * reach) + 1);
+		repainted++;
+	}
+	heatmap.pending.clear();
+	if (layer != NULL)
+	{
+		cairo_destroy(layer);
+	}
+	if (rebuild && changed)
+	{
+		gridLayer.stale = true;
+		gtk_widget_queue_draw(widget);
+	}
+	TRACE_COUNTER("heatmap repaints", repainted);
+	
+	if (simJob.running)
+		return G_SOURCE_CONTINUE;
+	heatmap.tick = 0;
+	return G_SOURCE_REMOVE;
+}
+
+static gboolean counters_tick(gpointer user_data)
+{
+	if (!gtk_widget_get_visible(WINDOWS.DiagnosticsWindow))
+		return TRUE;
+	
+	char text[256];
+	snprintf(text, sizeof(text), "Tracing %s (Ctrl+T), %lld events recorded\n", (traceOn.load(memory_order_relaxed) ? "on" : "off"), traceEventCount());
+	string counters = text;
+	vector<pair<string, long long>> values = traceCounterValues();
+	for (int i = 0; i < (int)values.size(); i++)
+	{
+		snprintf(text, sizeof(text), "%s: %lld\n", values[i].first.c_str(), values[i].second);
+		counters += text;
+	}
+	gtk_label_set_text(GTK_LABEL(diagLabels.counters), counters.c_str());
+	return TRUE;
+}
+
+static void toggleTracing()
+{
+	// switching tracing off writes out everything recorded since the program started
+	bool on = !traceOn.load(memory_order_relaxed);
+	traceSetEnabled(on);
+	if (on)
+	{
+		traceThreadName("GUI");
+		printf("Tracing on\n");
+	}
+	else if (traceExport(TRACE_FILE))
+	{
+		printf("Tracing off, trace written to %s\n", TRACE_FILE);
+	}
+}
+
+static void printRuns()
+{
+	long long events = 0, allocations = 0;
+	double wallSeconds = 0;
+	if (!simJob.points.empty())
+	{
+		int cached = 0;
+		for (int i = 0; i < (int)simJob.sweepRuns.size(); i++)
+		{
+			const sweepResult& r = simJob.sweepRuns[i];
+			const tileStats& total = r.summary.total;
+			const simParams& p = simJob.points[r.point];
+			if (!r.done)
+				continue;
+			printf("Point %i (bsLen %i, antNum %i, transNum %i, transDist %g, dRateMax %i, uePerAnt %i, bufSize %i) run %i: %lld generated, %lld served, %lld dropped, %lld blocked, mean delay %f s%s\n", r.point, p.bsLen, p.antNum, p.transNum, p.transDist, p.dRateMax, p.uePerAnt, p.bufSize, r.summary.run, total.arrivals, total.served, total.dropped, total.blocked, (total.served > 0 ? total.delaySum / total.served : 0.0), (r.cached ? " (cached)" : ""));
+			cached += r.cached;
+			events += (r.cached ? 0 : r.summary.events);
+			wallSeconds += (r.cached ? 0 : r.summary.wallSeconds);
+		}
+		printf("Sweep: %i runs taken from %s/, %lld events simulated in %.3f engine seconds -> %s_sweep.csv\n", cached, SWEEP_CACHE_DIR, events, wallSeconds, glob.simName.c_str());
+		return;
+	}
+	for (int i = 0; i < (int)simJob.runs.size(); i++)
+	{
+		const tileStats& total = simJob.runs[i].total;
+		printf("Run %i: %lld generated, %lld served, %lld dropped, %lld blocked, mean delay %f s -> %s\n", simJob.runs[i].run, total.arrivals, total.served, total.dropped, total.blocked, (total.served > 0 ? total.delaySum / total.served : 0.0), runFileName(glob.simName, simJob.runs[i].run).c_str());
+		events += simJob.runs[i].events;
+		wallSeconds += simJob.runs[i].wallSeconds;
+		allocations += simJob.runs[i].allocations;
+	}
+	printf("Simulated %i x %i s: %lld events in %.3f engine seconds (%.0f events/s per thread), %lld heap allocations in the event loop\n", (int)simJob.runs.size(), glob.simLen, events, wallSeconds, events / max(wallSeconds, 1e-9), allocations);
 }
 
 void backToDrawingStage()
@@ -348,556 +974,969 @@ static void drawHex(cairo_t *cr)
 {
 	if (glob.count == 0)
 	{
-		vector<double> test;
-		test.push_back(glob.screenWidth * 0.95 / 2.0);
-		test.push_back(glob.screenHeight * 0.95 / 2.0);
-		glob.coords.erase(glob.coords.begin(), glob.coords.end());
-		glob.coords.push_back(test);
-
 		glob.state.erase(glob.state.begin(), glob.state.end());
 		glob.state.push_back((int)0);
 
 		glob.path.erase(glob.path.begin(), glob.path.end());
 		glob.path.push_back(7);
+
+		glob.axial.erase(glob.axial.begin(), glob.axial.end());
+		glob.axial.push_back(make_pair(0, 0));
 		glob.count = 1;
+		indexTiles();
+		computeBounds();
+		fitView();
+	}
+	if (gridLayer.stale || gridLayer.surface == NULL)
+	{
+		if (gridLayer.surface != NULL)
+		{
+			cairo_surface_destroy(gridLayer.surface);
+		}
+		gridLayer.surface = cairo_surface_create_similar(cairo_get_target(cr), CAIRO_CONTENT_COLOR, (int)ceil(glob.screenWidth), (int)ceil(glob.screenHeight));
+		cairo_t* layer = cairo_create(gridLayer.surface);
+		drawGridLayer(layer);
+		cairo_destroy(layer);
+		gridLayer.stale = false;
 	}
+
+	// cached grid (cairo only copies the part inside the dirty region), then
+	// the selected tile with its highlighted side on top
+	cairo_set_source_surface(cr, gridLayer.surface, 0, 0);
+	cairo_paint(cr);
+	drawTile(cr, glob.selectedTile, true);
+}
+static void drawGridLayer(cairo_t *cr)
+{
+	TRACE_SCOPE("drawGridLayer");
   	cairo_set_source_rgb(cr, 1, 1, 1);
-	cairo_line_to(cr, 0, 0);
-	cairo_line_to(cr, 0, glob.screenHeight);
-	cairo_line_to(cr, glob.screenWidth, glob.screenHeight);
-	cairo_line_to(cr, glob.screenWidth, 0);
-	cairo_line_to(cr, 0, 0);
-	cairo_fill(cr);		
+	cairo_paint(cr);
 
-	double mousedY = glob.coords[glob.selectedTile][1] - glob.mouseY;
-	double mousedX = glob.mouseX - glob.coords[glob.selectedTile][0];
+	// only tiles (and the handovers leaving them) that reach into the layer
+	double side = glob.sideLength;
+	findVisibleTiles(2.0 * side + 4.0);
+	const vector<int>& tiles = gridLayer.visible;
+	TRACE_COUNTER("visible tiles", (long long)tiles.size());
+	if (side < CELL_MIN_SIDE)
+	{
+		drawCells(cr);
+		return;
+	}
 
-	double mouseparam = mousedY / mousedX;
-	double mouseslope = atan(mouseparam) * 180.0 / M_PI;
-	double mousedist = sqrt(mousedY * mousedY + mousedX * mousedX);
-	if (abs(mouseslope) >= 60)	
+	// corner offsets for the current side length
+	double cx[6], cy[6];
+	for (int k = 0; k < 6; k++)
 	{
-	 	if (mousedY < 0)
-	  	{
-		  	glob.highlightedSide = 0; // Bottom
-		}
-		else
-		{
-		 	glob.highlightedSide = 3; // Top
-		}
+		cx[k] = side * hexCorner[k][0];
+		cy[k] = side * hexCorner[k][1];
 	}
-	else
+
+	// Fill; the tiles are sorted by color, and all tiles of one color go into
+	// one path
+	int start[TILE_COLORS + 1] = {0};
+	for (int j = 0; j < (int)tiles.size(); j++)
 	{
-	  	if (mousedY < 0)
-	  	{
-	    	if (mousedX > 0)
-	    	{
-		   	glob.highlightedSide = 1;	// Bottom Right
-	    	}
-	    	else
-	    	{
-	     		glob.highlightedSide = 5;	// Bottom Left
-	    	}
-	  	}
-	  	else
-	  	{
-	    	if (mousedX > 0)
-	    	{
-		    	glob.highlightedSide = 2;	// Top Right
-	    	}
-		   else
-		   {
-		    	glob.highlightedSide = 4;	// Top Left
-		   }
-	  	}
+		start[tileColor(tiles[j]) + 1]++;
 	}
-  	cairo_set_source_rgb(cr, 0, 1, 0);
-  	cairo_set_line_width(cr, 2.0);
-	for (int i = 0; i < glob.count; i++)	// Fill
+	for (int color = 0; color < TILE_COLORS; color++)
 	{
-		if (i == glob.selectedTile)
-		{
-			cairo_set_source_rgb(cr, 0, 100.0/255.0, 0);
-		}
-		else
-		{
-			cairo_set_source_rgb(cr, 0, 200.0/255.0, 0);
-		}
-		cairo_line_to(cr, glob.coords[i][0] + glob.sideLength * sin(2 * M_PI / 6 * (0.5 + 5)), glob.coords[i][1] + glob.sideLength * cos(2 * M_PI / 6 * (0.5 + 5)));
-		
-		for (int j = 0; j <= 5; j++)
+		start[color + 1] += start[color];
+	}
+	int next[TILE_COLORS];
+	copy(start, start + TILE_COLORS, next);
+	vector<int>& byColor = gridLayer.byColor;
+	byColor.resize(tiles.size());
+	for (int j = 0; j < (int)tiles.size(); j++)
+	{
+		byColor[next[tileColor(tiles[j])]++] = tiles[j];
+	}
+	for (int color = 0; color < TILE_COLORS; color++)
+	{
+		if (start[color] == start[color + 1])
+			continue;
+		setTileColor(cr, color);
+		for (int j = start[color]; j < start[color + 1]; j++)
 		{
-			cairo_line_to(cr, glob.coords[i][0] + glob.sideLength * sin(2 * M_PI / 6 * (0.5 + j)), glob.coords[i][1] + glob.sideLength * cos(2 * M_PI / 6 * (0.5 + j)));	
+			coord c = tileCenter(byColor[j]);
+			cairo_move_to(cr, c.x + cx[5], c.y + cy[5]);
+			for (int k = 0; k < 5; k++)
+			{
+				cairo_line_to(cr, c.x + cx[k], c.y + cy[k]);
+			}
+			cairo_close_path(cr);
 		}
-		cairo_fill(cr);	
-	} 
-	for (int i = 0; i < glob.count; i++)	// Border
+		cairo_fill(cr);
+	}
+	if (side < BORDER_MIN_SIDE)
+		return;
+
+	// Border; a shared side is drawn once, by the tile above it (sides 3 - 5
+	// are always drawn, sides 0 - 2 only when there is no neighbor across them)
+	cairo_set_source_rgb(cr, 0, 0, 0);
+	cairo_set_line_width(cr, 2.0);
+	for (int j = 0; j < (int)tiles.size(); j++)
 	{
-		cairo_line_to(cr, glob.coords[i][0] + glob.sideLength * sin(2 * M_PI / 6 * (0.5 + 5)), glob.coords[i][1] + glob.sideLength * cos(2 * M_PI / 6 * (0.5 + 5)));
-		for (int k = 0; k <= 5; k++)
+		int i = tiles[j];
+		int q = glob.axial[i].first, r = glob.axial[i].second;
+		coord c = tileCenter(i);
+		bool penDown = false;
+		for (int n = 3; n < 9; n++)
 		{
-			cairo_set_source_rgb(cr, 0, 0, 0);
-      	cairo_set_line_width(cr, 2.0);
-			if (i == glob.selectedTile && k == glob.highlightedSide)
+			int k = n % 6;
+			if (n >= 6 && findTile(q + sideDir[k][0], r + sideDir[k][1]) != -1)
 			{
-				cairo_set_source_rgb(cr, 1, 0, 0);
-        		cairo_set_line_width(cr, 4.0);
+				penDown = false;
+				continue;
 			}
-			cairo_line_to(cr, glob.coords[i][0] + glob.sideLength * sin(2 * M_PI / 6 * (0.5 + k)), glob.coords[i][1] + glob.sideLength * cos(2 * M_PI / 6 * (0.5 + k)));
-			cairo_stroke(cr);	
-			if (k < 5)
+			if (!penDown)
 			{
-				cairo_line_to(cr, glob.coords[i][0] + glob.sideLength * sin(2 * M_PI / 6 * (0.5 + k)), glob.coords[i][1] + glob.sideLength * cos(2 * M_PI / 6 * (0.5 + k)));
+				cairo_move_to(cr, c.x + cx[(k + 5) % 6], c.y + cy[(k + 5) % 6]);
+				penDown = true;
 			}
+			cairo_line_to(cr, c.x + cx[k], c.y + cy[k]);
 		}
-	} 
-	cairo_line_to(cr, glob.coords[glob.selectedTile][0] + glob.sideLength * sin(2 * M_PI / 6 * (0.5 + 5)), glob.coords[glob.selectedTile][1] + glob.sideLength * cos(2 * M_PI / 6 * (0.5 + 5)));
-	for (int k = 0; k <= 5; k++)
+	}
+	cairo_stroke(cr);
+
+	// Handovers of the self-healing plan, from every donor toward the
+	// neighbors taking its UEs; thicker for a larger share
+	updateHealing();
+	for (int j = 0; j < (int)tiles.size(); j++)
 	{
-		cairo_set_source_rgb(cr, 0, 0, 0);
-    	cairo_set_line_width(cr, 2.0);
-		if (k == glob.highlightedSide)
-		{
-			cairo_set_source_rgb(cr, 1, 0, 0);
-      	cairo_set_line_width(cr, 4.0);
-		}
-		cairo_line_to(cr, glob.coords[glob.selectedTile][0] + glob.sideLength * sin(2 * M_PI / 6 * (0.5 + k)), glob.coords[glob.selectedTile][1] + glob.sideLength * cos(2 * M_PI / 6 * (0.5 + k)));
-		cairo_stroke(cr);	
-		if (k < 5)
+		drawHandovers(cr, tiles[j]);
+	}
+
+	// Numbers
+	if (side < LABEL_MIN_SIDE)
+		return;
+	for (int j = 0; j < (int)tiles.size(); j++)
+	{
+		addLabels(cr, tiles[j]);
+	}
+	showLabels(cr);
+}
+static void drawHandovers(cairo_t *cr, int i)
+{
+	// from the center of a donor to the sides it shares with the neighbors
+	// taking its UEs
+	if (i >= (int)glob.heal.moves.size())
+		return;
+	cairo_set_source_rgb(cr, 0, 0, 1);
+	coord from = tileCenter(i);
+	for (int k = 0; k < (int)glob.heal.moves[i].size(); k++)
+	{
+		coord to = tileCenter(glob.heal.moves[i][k].tile);
+		cairo_set_line_width(cr, 1.0 + glob.sideLength * 0.15 * glob.heal.moves[i][k].share);
+		cairo_move_to(cr, from.x, from.y);
+		cairo_line_to(cr, (from.x + to.x) / 2.0, (from.y + to.y) / 2.0);
+		cairo_stroke(cr);
+	}
+}
+static void drawCells(cairo_t *cr)
+{
+	// the layer at one pixel per CELL_PIXELS square, so the work depends on
+	// the pixels in view rather than on the tiles
+	int width = (int)ceil(glob.screenWidth / CELL_PIXELS), height = (int)ceil(glob.screenHeight / CELL_PIXELS);
+	if (gridLayer.cells == NULL || cairo_image_surface_get_width(gridLayer.cells) != width || cairo_image_surface_get_height(gridLayer.cells) != height)
+	{
+		if (gridLayer.cells != NULL)
 		{
-			cairo_line_to(cr, glob.coords[glob.selectedTile][0] + glob.sideLength * sin(2 * M_PI / 6 * (0.5 + k)), glob.coords[glob.selectedTile][1] + glob.sideLength * cos(2 * M_PI / 6 * (0.5 + k)));
+			cairo_surface_destroy(gridLayer.cells);
 		}
+		gridLayer.cells = cairo_image_surface_create(CAIRO_FORMAT_RGB24, width, height);
 	}
-	for (int i = 0; i < glob.count; i++)	// Numbers
-	{
-		string result, result2;
-		stringstream convert, convert2;
-		convert << i;
-		result = convert.str();
-		const char *c = result.c_str();
-
-		convert2 << glob.state[i];
-		result2 = convert2.str();
-		const char *c2 = result2.c_str();
+	gridLayer.cellColor.assign((size_t)width * height, -1);
 
-		cairo_set_source_rgb(cr, 1, 1, 1);
-		cairo_set_font_size(cr, glob.sideLength / 2.0);
-		if (i < 10)
+	// every tile marks the cells its bounding box overlaps
+	double halfW = glob.sideLength / CELL_PIXELS, halfH = glob.sideLength * sqrt(3) / 2.0 / CELL_PIXELS;
+	const vector<int>& tiles = gridLayer.visible;
+	for (int j = 0; j < (int)tiles.size(); j++)
+	{
+		int i = tiles[j];
+		int color = tileColor(i);
+		coord c = tileCenter(i);
+		double x = c.x / CELL_PIXELS, y = c.y / CELL_PIXELS;
+		int x0 = max(0, (int)floor(x - halfW)), x1 = min(width - 1, (int)floor(x + halfW));
+		int y0 = max(0, (int)floor(y - halfH)), y1 = min(height - 1, (int)floor(y + halfH));
+		for (int cy = y0; cy <= y1; cy++)
 		{
-			cairo_move_to(cr, glob.coords[i][0] - glob.sideLength / 2.0 / 3.0, glob.coords[i][1] + glob.sideLength / 2.0 / 3.0);
+			signed char* row = &gridLayer.cellColor[(size_t)cy * width];
+			for (int cx = x0; cx <= x1; cx++)
+			{
+				if (row[cx] < 0 || colorSeverity(color) > colorSeverity(row[cx]))
+					row[cx] = (signed char)color;
+			}
 		}
-		else if (i < 100)
+	}
+
+	// RGB24 pixels are native endian 0x00RRGGBB words
+	uint32_t colors[TILE_COLORS + 1];
+	colors[0] = 0xFFFFFF;
+	for (int color = 0; color < TILE_COLORS; color++)
+	{
+		double rgb[3];
+		tileRgb(color, rgb);
+		colors[color + 1] = ((uint32_t)(rgb[0] * 255) << 16) | ((uint32_t)(rgb[1] * 255) << 8) | (uint32_t)(rgb[2] * 255);
+	}
+	cairo_surface_flush(gridLayer.cells);
+	unsigned char* data = cairo_image_surface_get_data(gridLayer.cells);
+	int stride = cairo_image_surface_get_stride(gridLayer.cells);
+	for (int cy = 0; cy < height; cy++)
+	{
+		uint32_t* pixels = (uint32_t*)(data + (size_t)cy * stride);
+		const signed char* row = &gridLayer.cellColor[(size_t)cy * width];
+		for (int cx = 0; cx < width; cx++)
 		{
-			cairo_move_to(cr, glob.coords[i][0] - glob.sideLength / 2.0 / 3.0 * 2.0, glob.coords[i][1] + glob.sideLength / 2.0 / 3.0);
+			pixels[cx] = colors[row[cx] + 1];
 		}
-		cairo_show_text(cr, c);
-		
-		cairo_set_source_rgb(cr, 0, 0, 1);
-		cairo_move_to(cr, glob.coords[i][0] - glob.sideLength / 2.0 / 3.0, glob.coords[i][1] + glob.sideLength / 2.0 / 3.0 + glob.sideLength / 2.0);
-		cairo_show_text(cr, c2);
 	}
+	cairo_surface_mark_dirty(gridLayer.cells);
+
+	cairo_save(cr);
+	cairo_scale(cr, CELL_PIXELS, CELL_PIXELS);
+	cairo_set_source_surface(cr, gridLayer.cells, 0, 0);
+	cairo_pattern_set_filter(cairo_get_source(cr), CAIRO_FILTER_NEAREST);
+	cairo_paint(cr);
+	cairo_restore(cr);
 }
-static void button_clicked(GtkWidget* widget, gpointer data)
+static void findVisibleTiles(double margin)
 {
-	system("reset");
-	for (int i = 0; i < glob.count; i++)
-	{
-		printf("%i: (%f, %f, %i)\n", i, glob.coords[i][0], glob.coords[i][1], glob.path[i], glob.state[i]);
-	}
-	getNeighbors();
-	for (int n = 0; n < glob.count; n++)
+	// lattice box of the layer plus "margin" pixels on every side, clipped to
+	// the box of the grid; Y2 = 2 * r + q as in the bounds
+	vector<int>& tiles = gridLayer.visible;
+	tiles.clear();
+	double stepX = 1.5 * glob.sideLength, stepY = sqrt(3) / 2.0 * glob.sideLength;
+	double qLo = max((double)glob.minQ, floor((-margin - glob.viewX) / stepX));
+	double qHi = min((double)glob.maxQ, ceil((glob.screenWidth + margin - glob.viewX) / stepX));
+	double yLo = max((double)glob.minY2, floor((-margin - glob.viewY) / stepY));
+	double yHi = min((double)glob.maxY2, ceil((glob.screenHeight + margin - glob.viewY) / stepY));
+	if (qLo > qHi || yLo > yHi)
+		return;
+
+	// look up the cells of the box when it holds fewer cells than there are
+	// tiles (zoomed in), and test every tile against it otherwise
+	if ((qHi - qLo + 1) * (yHi - yLo + 1) / 2.0 < glob.count)
 	{
-		printf("Base Station: %i\n\tCan be deleted: %s\n\tNeighbors: ", n, (deletionValid(n) ? "true" : "false"));
-		for (int i = 0; i < glob.neighbors[n].size(); i++)
+		for (int q = (int)qLo; q <= (int)qHi; q++)
 		{
-			printf("(%i,%i)", glob.neighbors[n][i].first, glob.neighbors[n][i].second);
-			if(i < glob.neighbors[n].size() - 1)
+			// a cell's Y2 has the parity of its q
+			for (int y2 = (int)yLo + (((int)yLo - q) & 1); y2 <= (int)yHi; y2 += 2)
 			{
-				printf(", ");
+				int tile = findTile(q, (y2 - q) / 2);
+				if (tile != -1)
+					tiles.push_back(tile);
 			}
-		}	
-		printf("\n");
+		}
+	}
+	else
+	{
+		for (int i = 0; i < glob.count; i++)
+		{
+			int q = glob.axial[i].first, y2 = 2 * glob.axial[i].second + q;
+			if (q >= qLo && q <= qHi && y2 >= yLo && y2 <= yHi)
+				tiles.push_back(i);
+		}
 	}
-	printf("\n");
-	goToSimParams();
 }
-static gboolean mouse_moved(GtkWidget *widget, GdkEvent *event, gpointer user_data)
+static int tileColor(int i)
 {
-	if (event -> type == GDK_MOTION_NOTIFY)
- 	{
-  		GdkEventMotion* e = (GdkEventMotion*)event;
-		glob.mouseX = (guint)e -> x;
-		glob.mouseY = (guint)e -> y;
-		gtk_widget_queue_draw(widget);
-  	}
+	// the heatmap while it is on and has a sample of the tile, else green while
+	// the labels show the states and the state color without them
+	if (heatmap.on && i < (int)heatmap.color.size() && heatmap.color[i] >= 0)
+		return heatmap.color[i];
+	return (glob.sideLength >= LABEL_MIN_SIDE ? 0 : glob.state[i]);
 }
-static gboolean mouse_clicked(GtkWidget *widget, GdkEventButton *event, gpointer user_data)
+static void tileRgb(int color, double rgb[3])
 {
-	bool changeScale = false;
-	if (event->button == 1) //Left Mouse Click
-	{	
-		double dY = (glob.coords[glob.selectedTile][1] - event -> y);
-		double dX = (event -> x - glob.coords[glob.selectedTile][0]);
-		
-		double param = dY / dX;
-		double slope = atan(param) * 180.0 / M_PI;
-		double setX, setY;
-		int setPath;
-		double dist = sqrt(dY * dY + dX * dX);
-
-		bool changedTile = false;
-		double distance = sqrt(dY * dY + dX * dX);
-		double newdY, newdX, newDistance;
-		for(int i = 0; i < glob.count; i++)
+	if (color < 4)
+	{
+		rgb[0] = stateColor[color][0];
+		rgb[1] = stateColor[color][1];
+		rgb[2] = stateColor[color][2];
+		return;
+	}
+	// heat buckets from the healthy green through yellow to red
+	double t = (color - 4) / (double)(HEAT_BUCKETS - 1);
+	rgb[0] = min(1.0, 2.0 * t);
+	rgb[1] = min(1.0, 2.0 * (1.0 - t)) * 200.0 / 255.0;
+	rgb[2] = 0;
+}
+static void setTileColor(cairo_t *cr, int color)
+{
+	double rgb[3];
+	tileRgb(color, rgb);
+	cairo_set_source_rgb(cr, rgb[0], rgb[1], rgb[2]);
+}
+static int colorSeverity(int color)
+{
+	// a cell shows the fill of its most severe tile
+	return (color < 4 ? stateSeverity[color] : color);
+}
+static void drawTile(cairo_t *cr, int i, bool selected)
+{
+	coord c = tileCenter(i);
+	double x = c.x, y = c.y;
+	if (selected)
+	{
+		cairo_set_source_rgb(cr, 0, 100.0/255.0, 0);
+	}
+	else
+	{
+		setTileColor(cr, tileColor(i));
+	}
+	cairo_move_to(cr, x + glob.sideLength * hexCorner[5][0], y + glob.sideLength * hexCorner[5][1]);
+	for (int k = 0; k < 5; k++)
+	{
+		cairo_line_to(cr, x + glob.sideLength * hexCorner[k][0], y + glob.sideLength * hexCorner[k][1]);
+	}
+	cairo_close_path(cr);
+	cairo_fill(cr);
+
+	if (glob.sideLength < BORDER_MIN_SIDE)
+		return;
+	updateHealing();
+	drawHandovers(cr, i);
+
+	// Border; black sides in one stroke, then the highlighted side on top
+	int highlight = (selected ? glob.highlightedSide : -1);
+	cairo_set_source_rgb(cr, 0, 0, 0);
+	cairo_set_line_width(cr, 2.0);
+	for (int k = 0; k < 6; k++)
+	{
+		if (k == highlight)
+			continue;
+		cairo_move_to(cr, x + glob.sideLength * hexCorner[(k + 5) % 6][0], y + glob.sideLength * hexCorner[(k + 5) % 6][1]);
+		cairo_line_to(cr, x + glob.sideLength * hexCorner[k][0], y + glob.sideLength * hexCorner[k][1]);
+	}
+	cairo_stroke(cr);
+	if (highlight != -1)
+	{
+		cairo_set_source_rgb(cr, 1, 0, 0);
+		cairo_set_line_width(cr, 4.0);
+		cairo_move_to(cr, x + glob.sideLength * hexCorner[(highlight + 5) % 6][0], y + glob.sideLength * hexCorner[(highlight + 5) % 6][1]);
+		cairo_line_to(cr, x + glob.sideLength * hexCorner[highlight][0], y + glob.sideLength * hexCorner[highlight][1]);
+		cairo_stroke(cr);
+	}
+
+	if (glob.sideLength >= LABEL_MIN_SIDE)
+	{
+		addLabels(cr, i);
+		showLabels(cr);
+	}
+}
+static void addLabels(cairo_t *cr, int i)
+{
+	double fontSize = glob.sideLength / 2.0;
+	if (labelGlyphs.sideLength != glob.sideLength)
+	{
+		cairo_set_font_size(cr, fontSize);
+		cairo_scaled_font_t* font = cairo_get_scaled_font(cr);
+		bool shaped = true;
+		for (int d = 0; d < 10 && shaped; d++)
 		{
-			newdY = (glob.coords[i][1] - event -> y);
-			newdX = (event -> x - glob.coords[i][0]);
-			
-			newDistance = sqrt(newdY * newdY + newdX * newdX);
-			if (distance > newDistance)
+			char text[2] = {(char)('0' + d), 0};
+			cairo_glyph_t* glyphs = NULL;
+			int count = 0;
+			cairo_text_extents_t extents;
+			shaped = (cairo_scaled_font_text_to_glyphs(font, 0, 0, text, 1, &glyphs, &count, NULL, NULL, NULL) == CAIRO_STATUS_SUCCESS && glyphs != NULL && count >= 1);
+			if (shaped)
 			{
-				distance = newDistance;
-				if (distance < glob.sideLength * sqrt(3) / 2)	// If click is inside hex
-				{
-					glob.selectedTile = i;
-					changedTile = true;
-				}
+				cairo_scaled_font_glyph_extents(font, glyphs, 1, &extents);
+				labelGlyphs.digit[d] = glyphs[0].index;
+				labelGlyphs.advance[d] = extents.x_advance;
 			}
+			cairo_glyph_free(glyphs);
 		}
-		if(!changedTile)
+		if (!shaped)
 		{
-			if (dist > glob.sideLength * sqrt(3) / 2)
-			{
-				if (abs(slope) >= 60)
-				{
-				 	if (dY < 0)	// Bottom
-				  	{
-					 	setX = glob.coords[glob.selectedTile][0];
-					 	setY = glob.coords[glob.selectedTile][1] + glob.sideLength * sqrt(3);
-					 	setPath = 0;
-					}
-					else  // Top
-					{
-					 	setX = glob.coords[glob.selectedTile][0];
-					 	setY = glob.coords[glob.selectedTile][1] - glob.sideLength * sqrt(3);
-					 	setPath = 3;
-					}
-				}
-				else
-				{
-				  	if (dY < 0)
-				  	{
-				    	if (dX > 0)	// Bottom Right
-				    	{
-					    	setX = glob.coords[glob.selectedTile][0] + glob.sideLength * 1.5;
-					    	setY = glob.coords[glob.selectedTile][1] + glob.sideLength * sqrt(3) / 2;
-					    	setPath = 5;
-					  	}
-					  	else	// Bottom Left
-					  	{
-					    	setX = glob.coords[glob.selectedTile][0] - glob.sideLength * 1.5;
-					    	setY = glob.coords[glob.selectedTile][1] + glob.sideLength * sqrt(3) / 2;
-					    	setPath = 1;
-					  	}
-				  	}
-				  	else
-				  	{
-				    	if (dX > 0)	// Top Right
-				    	{
-					    	setX = glob.coords[glob.selectedTile][0] + glob.sideLength * 1.5;
-					    	setY = glob.coords[glob.selectedTile][1] - glob.sideLength * sqrt(3) / 2;
-					    	setPath = 4;
-					  	}
-					  	else	// Top Left
-					  	{
-					    	setX = glob.coords[glob.selectedTile][0] - glob.sideLength * 1.5;
-					    	setY = glob.coords[glob.selectedTile][1] - glob.sideLength * sqrt(3) / 2;
-					    	setPath = 2;
-					  	}
-				  	}
-				}
-				bool pointExists = false;
-				for (int i = 0; i < glob.count; i++)
-				{
-					if (round(glob.coords[i][0]) == round(setX) && round(glob.coords[i][1]) == round(setY))
-					{
-						pointExists = true;
-						break;
-					}
-				}
-				if (!pointExists)
-				{			
-					vector<double> test;
-					test.push_back(setX);
-					test.push_back(setY);
-					glob.coords.push_back(test);
+			// the font could not shape the digits: the cache stays unbuilt and
+			// the label is drawn as text right away
+			showLabelText(cr, i);
+			return;
+		}
+		labelGlyphs.sideLength = glob.sideLength;
+	}
 
-					glob.state.push_back((int)0);
+	// digits of the index, last first
+	int digits[12];
+	int n = 0;
+	double width = 0;
+	for (unsigned value = (unsigned)i; n == 0 || value > 0; value /= 10)
+	{
+		digits[n] = value % 10;
+		width += labelGlyphs.advance[digits[n++]];
+	}
 
-					glob.path[glob.count - 1] = setPath;
+	// the index is centered on the tile, however many digits it has, and the
+	// state goes below it
+	coord center = tileCenter(i);
+	cairo_glyph_t glyph;
+	glyph.x = center.x - width / 2.0;
+	glyph.y = center.y + fontSize / 3.0;
+	while (n > 0)
+	{
+		int d = digits[--n];
+		glyph.index = labelGlyphs.digit[d];
+		labelGlyphs.indices.push_back(glyph);
+		glyph.x += labelGlyphs.advance[d];
+	}
+	glyph.index = labelGlyphs.digit[glob.state[i]];
+	glyph.x = center.x - fontSize / 3.0;
+	glyph.y = center.y + fontSize / 3.0 + fontSize;
+	labelGlyphs.states.push_back(glyph);
+}
+static void showLabelText(cairo_t *cr, int i)
+{
+	// the same label as addLabels() places, without the cached glyphs
+	double fontSize = glob.sideLength / 2.0;
+	string index = to_string(i);
+	char state[2] = {(char)('0' + glob.state[i]), 0};
+	cairo_text_extents_t extents;
+	coord center = tileCenter(i);
+	cairo_set_font_size(cr, fontSize);
+	cairo_text_extents(cr, index.c_str(), &extents);
+	cairo_set_source_rgb(cr, 1, 1, 1);
+	cairo_move_to(cr, center.x - extents.x_advance / 2.0, center.y + fontSize / 3.0);
+	cairo_show_text(cr, index.c_str());
+	cairo_set_source_rgb(cr, 0, 0, 1);
+	cairo_move_to(cr, center.x - fontSize / 3.0, center.y + fontSize / 3.0 + fontSize);
+	cairo_show_text(cr, state);
+}
+static void showLabels(cairo_t *cr)
+{
+	// every label added since the last call, in one run per color
+	cairo_set_font_size(cr, glob.sideLength / 2.0);
+	cairo_set_source_rgb(cr, 1, 1, 1);
+	cairo_show_glyphs(cr, labelGlyphs.indices.data(), (int)labelGlyphs.indices.size());
+	cairo_set_source_rgb(cr, 0, 0, 1);
+	cairo_show_glyphs(cr, labelGlyphs.states.data(), (int)labelGlyphs.states.size());
+	labelGlyphs.indices.clear();
+	labelGlyphs.states.clear();
+}
+static int pointerSide(double x, double y)
+{
+	// side of the selected tile the pointer is pointing at
+	coord c = tileCenter(glob.selectedTile);
+	double mousedY = c.y - y;
+	double mousedX = x - c.x;
 
-					glob.selectedTile = glob.count;
-					glob.count += 1;
-					changeScale = true;
-				}
-			}
-			else	// If inside the hexagon, cycle states
-			{
-				if(glob.state[glob.selectedTile] >= 3)
-				{
-					glob.state[glob.selectedTile] = 0;	
-				}
-				else
-				{
-					glob.state[glob.selectedTile] += 1;
-				}
-			}
+	double mouseparam = mousedY / mousedX;
+	double mouseslope = atan(mouseparam) * 180.0 / M_PI;
+	if (abs(mouseslope) >= 60)	
+	{
+	 	if (mousedY < 0)
+	  	{
+		  	return 0; // Bottom
 		}
-  	}
-	if (event->button == 3)	// Right Mouse Click
+		else
+		{
+		 	return 3; // Top
+		}
+	}
+	else
 	{
-		double dY = (glob.coords[glob.selectedTile][1] - event -> y);
-		double dX = (event -> x - glob.coords[glob.selectedTile][0]);
-		
-		double param = dY / dX;
-		double slope = atan(param) * 180.0 / M_PI;
-		double distance = sqrt(dY * dY + dX * dX);
-		double newdY, newdX, newDistance;
-		bool foundClick = false;
-		for(int i = 0; i < glob.count; i++)
+	  	if (mousedY < 0)
+	  	{
+	    	if (mousedX > 0)
+	    	{
+		   	return 1;	// Bottom Right
+	    	}
+	    	else
+	    	{
+	     		return 5;	// Bottom Left
+	    	}
+	  	}
+	  	else
+	  	{
+	    	if (mousedX > 0)
+	    	{
+		    	return 2;	// Top Right
+	    	}
+		   else
+		   {
+		    	return 4;	// Top Left
+		   }
+	  	}
+	}
+}
+static hexHit hitTest(double x, double y)
+{
+	hexHit hit;
+
+	// position in lattice units, undoing the view transform
+	double px = (x - glob.viewX) / glob.sideLength;
+	double py = (y - glob.viewY) / glob.sideLength;
+
+	// fractional axial coordinate, rounded to the nearest cube coordinate
+	double fq = px * 2.0 / 3.0;
+	double fr = py / sqrt(3) - px / 3.0;
+	double fs = -fq - fr;
+	double rq = round(fq), rr = round(fr), rs = round(fs);
+	double errQ = fabs(rq - fq), errR = fabs(rr - fr), errS = fabs(rs - fs);
+	if (errQ > errR && errQ > errS)
+	{
+		rq = -rr - rs;
+	}
+	else if (errR > errS)
+	{
+		rr = -rq - rs;
+	}
+
+	hit.q = (int)rq;
+	hit.r = (int)rr;
+	hit.tile = findTile(hit.q, hit.r);
+	hit.side = pointerSide(x, y);
+	return hit;
+}
+static coord tileCenter(int tile)
+{
+	coord c;
+	c.x = glob.viewX + glob.sideLength * 1.5 * glob.axial[tile].first;
+	c.y = glob.viewY + glob.sideLength * sqrt(3) * (glob.axial[tile].second + glob.axial[tile].first / 2.0);
+	return c;
+}
+static void queueSideDraw(GtkWidget *widget, int tile, int sideA, int sideB)
+{
+	// redraw only the box around two sides of a tile (plus the thick line width)
+	double minX = glob.screenWidth, minY = glob.screenHeight, maxX = 0, maxY = 0;
+	coord c = tileCenter(tile);
+	int sides[2] = {sideA, sideB};
+	for (int n = 0; n < 2; n++)
+	{
+		for (int k = sides[n] + 5; k <= sides[n] + 6; k++)
 		{
-			if(!foundClick)
-			{
-				newdY = (glob.coords[i][1] - event -> y);
-				newdX = (event -> x - glob.coords[i][0]);
-				
-				newDistance = sqrt(newdY * newdY + newdX * newdX);
-				printf("Pass: %i\n", i);
-				if (distance > newDistance)
-				{
-					distance = newDistance;
-					if (round(distance) < round(glob.sideLength * sqrt(3) / 2))	// If click is inside hex
-					{
-						foundClick = true;
-						if(glob.count > 1)
-						{
-							getNeighbors();
-							if(deletionValid(i))
-							{
-								printf("Deleting: %i\n", i);
-								glob.coords.erase(glob.coords.begin() + i);
-								glob.state.erase(glob.state.begin() + i);
-								glob.count -= 1;
-								glob.selectedTile = 0;
-								changeScale = true;
-							}
-							else
-							{
-								printf("Deletion invalid\n");
-							}
-						}
-						else
-						{
-							printf("Last tile cannot be deleted\n");
-						}
-					}
-				}
-				else if (round(distance) < round(glob.sideLength * sqrt(3) / 2))	// If click is inside hex
-				{
-					foundClick = true;	
-					if(glob.count > 1)
-					{
-						getNeighbors();		
-						if(deletionValid(i))
-						{
-							printf("Deleting: %i\n", glob.selectedTile);
-							glob.coords.erase(glob.coords.begin() + glob.selectedTile);
-							glob.state.erase(glob.state.begin() + i);	
-							glob.count -= 1;
-							glob.selectedTile = 0;
-							changeScale = true;
-						}
-						else
-						{
-							printf("Deletion invalid\n");
-						}
-					}
-					else
-					{
-						printf("Last tile cannot be deleted\n");
-					}
-				}
-			}
-			else
+			double x = c.x + glob.sideLength * hexCorner[k % 6][0];
+			double y = c.y + glob.sideLength * hexCorner[k % 6][1];
+			minX = min(minX, x);
+			maxX = max(maxX, x);
+			minY = min(minY, y);
+			maxY = max(maxY, y);
+		}
+	}
+	gtk_widget_queue_draw_area(widget, (int)floor(minX) - 3, (int)floor(minY) - 3, (int)ceil(maxX - minX) + 7, (int)ceil(maxY - minY) + 7);
+}
+static void button_clicked(GtkWidget* widget, gpointer data)
+{
+	// build the whole dump first and print it with a single write
+	string dump;
+	char line[128];
+	for (int i = 0; i < glob.count; i++)
+	{
+		snprintf(line, sizeof(line), "%i: (%i, %i, %i, %i)\n", i, glob.axial[i].first, glob.axial[i].second, glob.path[i], glob.state[i]);
+		dump += line;
+	}
+	updateConnectivity();
+	for (int n = 0; n < glob.count; n++)
+	{
+		snprintf(line, sizeof(line), "Base Station: %i\n\tCan be deleted: %s\n\tNeighbors: ", n, (deletionValid(n) ? "true" : "false"));
+		dump += line;
+		for (int i = 0; i < (int)glob.neighbors[n].size(); i++)
+		{
+			snprintf(line, sizeof(line), "(%i,%i)", glob.neighbors[n][i].first, glob.neighbors[n][i].second);
+			dump += line;
+			if(i < (int)glob.neighbors[n].size() - 1)
 			{
-				break;
+				dump += ", ";
 			}
-		}
+		}	
+		dump += "\n";
 	}
-	if (changeScale)	// Work on this part, needs to scale larger if tiles are deleted
-	{		
-		float ratio = 1.0;
-		float minX, maxX, minY, maxY, difX, difY, numX, numY;
-		minX = glob.coords[0][0];
-		maxX = glob.coords[0][0];
-		minY = glob.coords[0][1];
-		maxY = glob.coords[0][1];
-		for(int i = 1; i < glob.count; i++)
+	dump += "\n";
+	fwrite(dump.data(), 1, dump.size(), stdout);
+	goToSimParams();
+}
+static gboolean mouse_moved(GtkWidget *widget, GdkEvent *event, gpointer user_data)
+{
+	if (event -> type == GDK_MOTION_NOTIFY)
+ 	{
+  		GdkEventMotion* e = (GdkEventMotion*)event;
+
+		// dragging with the middle button pans the view
+		if (e -> state & GDK_BUTTON2_MASK)
+		{
+			panView(e -> x - glob.mouseX, e -> y - glob.mouseY);
+			gtk_widget_queue_draw(widget);
+		}
+		glob.mouseX = e -> x;
+		glob.mouseY = e -> y;
+
+		// only the old and new highlighted side need repainting
+		if (glob.count > 0)
 		{
-			if (minX > glob.coords[i][0])
+			int newSide = pointerSide(glob.mouseX, glob.mouseY);
+			if (newSide != glob.highlightedSide)
 			{
-				minX = glob.coords[i][0];
+				queueSideDraw(widget, glob.selectedTile, glob.highlightedSide, newSide);
+				glob.highlightedSide = newSide;
 			}
-			if (maxX < glob.coords[i][0])
+		}
+  	}
+	return FALSE;
+}
+// a running simulation and its heatmap number tiles as the network was when
+// the run started, so the network is not changed until it ends
+static bool gridLocked()
+{
+	if (simJob.running)
+		printf("The network cannot be changed while a simulation is running\n");
+	return simJob.running;
+}
+static gboolean mouse_clicked(GtkWidget *widget, GdkEventButton *event, gpointer user_data)
+{
+	// "path" code stored for a tile placed across each side of the selected tile
+	static const int sidePath[6] = {0, 5, 4, 3, 2, 1};
+
+	TRACE_SCOPE("mouse_clicked");
+	bool changeScale = false;
+	hexHit hit = hitTest(event -> x, event -> y);
+	if (event->button == 1) //Left Mouse Click
+	{	
+		if (hit.tile == glob.selectedTile)	// If inside the hexagon, cycle states
+		{
+			if (gridLocked())
+				return TRUE;
+			if(glob.state[glob.selectedTile] >= 3)
 			{
-				maxX = glob.coords[i][0];
+				glob.state[glob.selectedTile] = 0;	
 			}
-			if (minY > glob.coords[i][1])
+			else
 			{
-				minY = glob.coords[i][1];
+				glob.state[glob.selectedTile] += 1;
 			}
-			if (maxY < glob.coords[i][1])
+			// a state change only re-plans the handovers around the tile
+			if (!glob.healStale && !glob.topologyStale)
 			{
-				maxY = glob.coords[i][1];
+				setHealingState(glob.heal, glob.neighbors, glob.selectedTile, glob.state[glob.selectedTile]);
 			}
+			heatmap.on = false;
+			gridLayer.stale = true;
 		}
-		difX = abs(maxX - minX);
-		difY = abs(maxY - minY);
-		numX = ceil(difX / (glob.sideLength*sqrt(3) / 2)) / 2 + 1;
-		numY = ceil(difY / (glob.sideLength*sqrt(3) / 2)) / 2 + 1;
-		printf("NumX: %f\nNumY: %f\n", numX, numY);
+		else if (hit.tile != -1)	// If inside another hexagon, select it
+		{
+			glob.selectedTile = hit.tile;
+		}
+		else if (!gridLocked())	// Otherwise add a tile across the side of the selected tile facing the click
+		{
+			int dq = sideDir[hit.side][0], dr = sideDir[hit.side][1];
+			int setQ = glob.axial[glob.selectedTile].first + dq;
+			int setR = glob.axial[glob.selectedTile].second + dr;
+			if (findTile(setQ, setR) == -1)
+			{			
+				glob.state.push_back((int)0);
 
-		double prevSideLength = glob.sideLength;
+				glob.path[glob.count - 1] = sidePath[hit.side];
+				glob.path.push_back(7);
 
-		if(glob.count == 1)	// Good
-		{
-			ratio = (glob.screenHeight * 0.25) / glob.sideLength;
-			minX = glob.screenWidth * 0.95 / 2.0;
-			maxX = glob.screenWidth * 0.95 / 2.0;
-			minY = glob.screenHeight * 0.95 / 2.0;
-			maxY = glob.screenHeight * 0.95 / 2.0;
-			difX = 0;
-			difY = 0;
-			glob.coords[0][0] = glob.screenWidth * 0.95 / 2.0;
-			glob.coords[0][1] = glob.screenHeight * 0.95 / 2.0;
+				glob.axial.push_back(make_pair(setQ, setR));
+				glob.hexIndex[hexKey(setQ, setR)] = glob.count;
+				glob.topologyStale = true;
+				growBounds(setQ, setR);
+
+				glob.selectedTile = glob.count;
+				glob.count += 1;
+				changeScale = true;
+			}
 		}
-		// If shrinking
-		else if ((glob.sideLength*sqrt(3) * numX) > glob.screenWidth * 0.95 || (glob.sideLength*sqrt(3) * numY) > glob.screenHeight * 0.95)
+  	}
+	if (event->button == 3 && hit.tile != -1 && !gridLocked())	// Right Mouse Click
+	{
+		if(glob.count > 1)
 		{
-			printf("Shrinking\n");
-			bool keepShrinking = true;
-			while(keepShrinking)
+			if(deletionValid(hit.tile))
 			{
-				if ((glob.sideLength*sqrt(3) * numX) > glob.screenWidth * 0.95 || (glob.sideLength*sqrt(3) * numY) > glob.screenHeight * 0.95)
-				{
-					glob.sideLength *= 0.999;	
-				}
-				else
-				{
-					keepShrinking = false;
-				}
+				printf("Deleting: %i\n", hit.tile);
+				glob.state.erase(glob.state.begin() + hit.tile);
+				glob.path.erase(glob.path.begin() + hit.tile);
+				glob.axial.erase(glob.axial.begin() + hit.tile);
+				glob.count -= 1;
+				indexTiles();
+				computeBounds();
+				glob.selectedTile = 0;
+				changeScale = true;
+			}
+			else
+			{
+				printf("Deletion invalid\n");
 			}
 		}
 		else
 		{
-			printf("Growing\n");
-			bool keepGrowing = true;
-			while(keepGrowing)
-			{
-				if (!((glob.sideLength*sqrt(3) * numX) > glob.screenWidth * 0.95 || (glob.sideLength*sqrt(3) * numY) > glob.screenHeight * 0.95))
-				{
-					glob.sideLength *= 1.001;	
-				}
-				else
-				{
-					keepGrowing = false;
-				}
-			}
+			printf("Last tile cannot be deleted\n");
 		}
-		ratio = glob.sideLength / prevSideLength;
-		for (int i = 0; i < glob.count; i++)
+	}
+	if (changeScale)
+	{
+		heatmap.on = false;
+		if (glob.autoFit)
 		{
-			glob.coords[i][0] = (glob.coords[i][0] - glob.screenWidth * 0.95 / 2.0) * ratio + glob.screenWidth * 0.95 / 2.0 - (minX + difX / 2.0 - glob.screenWidth * 0.95 / 2.0);
-			glob.coords[i][1] = (glob.coords[i][1] - glob.screenHeight * 0.95 / 2.0) * ratio + glob.screenHeight * 0.95 / 2.0 + (glob.screenHeight * 0.95 / 2.0 - (maxY - difY / 2.0));
+			fitView();
 		}
+		gridLayer.stale = true;
 	}
+	glob.highlightedSide = pointerSide(event -> x, event -> y);
+	glob.clickTime = traceNow();
 	gtk_widget_queue_draw(widget);
   	return TRUE;
 }
 static gboolean on_draw_event(GtkWidget *widget, cairo_t *cr, gpointer user_data)
 {
- 	drawHex(cr);
+	long long start = traceNow();
+	{
+		TRACE_SCOPE("on_draw_event");
+		drawHex(cr);
+	}
+	long long end = traceNow();
+	TRACE_COUNTER("draw us", (end - start) / 1000);
+	if (glob.clickTime >= 0)
+	{
+		TRACE_COUNTER("click to paint us", (end - glob.clickTime) / 1000);
+		glob.clickTime = -1;
+	}
  	return FALSE;
 }
 static void getNeighbors()
 {
-	for (int k = 0; k < glob.count; k++)	// Wipes the neighbors so it doesn't retain old neighbors
+	long long start = traceNow();
 	{
-		glob.neighbors[k].erase(glob.neighbors[k].begin(), glob.neighbors[k].end());
-	}
-	for (int n = 0; n < glob.count; n++)
-	{
-		for (int i = 0; i < glob.count; i++)
-		{
-			if(i != n && round(distance(glob.coords[i][0], glob.coords[i][1], glob.coords[n][0], glob.coords[n][1])) == round(glob.sideLength*sqrt(3)))
-			{
-				glob.neighbors[n].push_back(make_pair(i,side(glob.coords[i][0], glob.coords[i][1], glob.coords[n][0], glob.coords[n][1])));
-			}
-		}
+		TRACE_SCOPE("getNeighbors");
+		buildNeighbors(glob.axial, glob.hexIndex, glob.neighbors);
 	}
+	TRACE_COUNTER("getNeighbors us", (traceNow() - start) / 1000);
 }
 static bool deletionValid(int tile)
 {
-	bool* nodeExplored = new bool[glob.count];
-	for (int n = 0; n < glob.count; n++)
-		nodeExplored[n] = false;
+	// a tile can be removed as long as it is not a cut vertex of the hex graph
+	updateConnectivity();
+	return !glob.cutTile[tile];
+}
+static void findCutTiles()
+{
+	TRACE_SCOPE("findCutTiles");
+	// single iterative DFS (Hopcroft-Tarjan low-link) marking every cut vertex
+	glob.cutTile.assign(glob.count, false);
+	if (glob.count == 0)
+		return;
 
-	std::vector<int> nodesToExplore = {(tile + 1) % glob.count};	//element, guaranteed to exist.
+	vector<int> order(glob.count, -1), low(glob.count, 0), parent(glob.count, -1), next(glob.count, 0);
+	vector<int> nodesToExplore = {0};
+	int visited = 0, rootChildren = 0;
+	order[0] = low[0] = visited++;
 
-	int N;
 	while (!nodesToExplore.empty())
 	{
-		N = nodesToExplore.back();
-		nodesToExplore.pop_back();
-
-		if(N == tile)
+		int N = nodesToExplore.back();
+		if (next[N] < (int)glob.neighbors[N].size())
+		{
+			int c = glob.neighbors[N][next[N]++].first;
+			if (order[c] == -1)
+			{
+				parent[c] = N;
+				order[c] = low[c] = visited++;
+				nodesToExplore.push_back(c);
+			}
+			else if (c != parent[N])
+			{
+				low[N] = min(low[N], order[c]);
+			}
 			continue;
+		}
 
-		nodeExplored[N] = true;
+		// all children of N are done; fold its low-link into the parent
+		nodesToExplore.pop_back();
+		int P = parent[N];
+		if (P == -1)
+			continue;
+		low[P] = min(low[P], low[N]);
+		if (parent[P] == -1)
+			rootChildren++;
+		else if (low[N] >= order[P])
+			glob.cutTile[P] = true;
+	}
+	glob.cutTile[0] = (rootChildren > 1);
 
-		for (int c = 0; c < glob.neighbors[N].size(); c++)
-		{
-			if(!nodeExplored[glob.neighbors[N][c].first])
-				nodesToExplore.push_back(glob.neighbors[N][c].first);
-		}
+	// a network that is already split cannot safely lose any tile
+	if (visited < glob.count)
+		glob.cutTile.assign(glob.count, true);
+}
+static void updateConnectivity()
+{
+	// neighbors and cut tiles are only rebuilt after the layout has changed
+	if (!glob.topologyStale)
+		return;
+	getNeighbors();
+	findCutTiles();
+	glob.topologyStale = false;
+	glob.healStale = true;
+}
+static void updateHealing()
+{
+	// the plan is only rebuilt in full after the layout or the parameters changed
+	updateConnectivity();
+	if (!glob.healStale)
+		return;
+	simTopology topo;
+	topo.state = glob.state;
+	topo.neighbors = glob.neighbors;
+	initHealing(glob.heal, topo, getSimParams());
+	glob.healStale = false;
+}
+static int findTile(int q, int r)
+{
+	return findCell(glob.hexIndex, q, r);
+}
+static void indexTiles()
+{
+	// rebuild the (q,r) -> tile map; tile indices shift whenever a tile is erased
+	glob.topologyStale = true;
+	indexLayout(glob.axial, glob.hexIndex);
+}
+static void growBounds(int q, int r)
+{
+	glob.minQ = min(glob.minQ, q);
+	glob.maxQ = max(glob.maxQ, q);
+	glob.minY2 = min(glob.minY2, 2 * r + q);
+	glob.maxY2 = max(glob.maxY2, 2 * r + q);
+}
+static void computeBounds()
+{
+	glob.minQ = glob.maxQ = glob.axial[0].first;
+	glob.minY2 = glob.maxY2 = 2 * glob.axial[0].second + glob.axial[0].first;
+	for (int i = 1; i < glob.count; i++)
+	{
+		growBounds(glob.axial[i].first, glob.axial[i].second);
 	}
-	for (int n = 0; n < glob.count; n++)
-		if(nodeExplored[n] == false && n != tile)
-			return false;
+}
+static void fitView()
+{
+	// closed-form fit of the lattice bounding box (plus one hexagon) into the
+	// drawing area, never larger than the size of the first tile
+	double areaW = glob.screenWidth * 0.95, areaH = glob.screenHeight * 0.95;
+	double unitsW = 1.5 * (glob.maxQ - glob.minQ) + 2.0;
+	double unitsH = sqrt(3) / 2.0 * (glob.maxY2 - glob.minY2) + sqrt(3);
+	glob.sideLength = min(glob.screenHeight * 0.25, min(areaW / unitsW, areaH / unitsH));
 
-	return true;
+	// center of the bounding box goes to the center of the drawing area
+	glob.viewX = areaW / 2.0 - glob.sideLength * 1.5 * (glob.minQ + glob.maxQ) / 2.0;
+	glob.viewY = areaH / 2.0 - glob.sideLength * sqrt(3) / 2.0 * (glob.minY2 + glob.maxY2) / 2.0;
+	glob.autoFit = true;
+	gridLayer.stale = true;
 }
-static float distance(double x1, double y1, double x2, double y2)
+static void zoomView(double factor, double x, double y)
 {
-	double dY = y2 - y1;
-	double dX = x2 - x1;
-	double distance = sqrt(dY * dY + dX * dX);
-	return distance;
+	// scale about (x, y) so the point under the pointer stays put
+	factor = min(max(factor, MIN_SIDE / glob.sideLength), MAX_SIDE / glob.sideLength);
+	glob.sideLength *= factor;
+	glob.viewX = x - (x - glob.viewX) * factor;
+	glob.viewY = y - (y - glob.viewY) * factor;
+	glob.autoFit = false;
+	gridLayer.stale = true;
 }
-static int side(double x1, double y1, double x2, double y2)
+static void panView(double dx, double dy)
 {
-	double dY = y1 - y2;
-	double dX = x1 - x2;
-	double angle = atan(dY/dX);
-	if(dX > 0)
-		angle = (angle > 0 ? angle : angle + 2 * M_PI);
+	glob.viewX += dx;
+	glob.viewY += dy;
+	glob.autoFit = false;
+	gridLayer.stale = true;
+}
+static gboolean mouse_scrolled(GtkWidget *widget, GdkEventScroll *event, gpointer user_data)
+{
+	if (event -> direction == GDK_SCROLL_UP)
+	{
+		zoomView(1.1, event -> x, event -> y);
+	}
+	else if (event -> direction == GDK_SCROLL_DOWN)
+	{
+		zoomView(1.0 / 1.1, event -> x, event -> y);
+	}
 	else
-		angle = M_PI - angle;
-	int side = ((int)(angle/(M_PI/3)));
-	return side;
+	{
+		return FALSE;
+	}
+	gtk_widget_queue_draw(widget);
+	return TRUE;
+}
+static gboolean key_pressed(GtkWidget *widget, GdkEventKey *event, gpointer user_data)
+{
+	// Home or 0 fits the whole grid again and turns auto-fit back on
+	if (event -> keyval == GDK_KEY_Home || event -> keyval == GDK_KEY_0)
+	{
+		fitView();
+		gtk_widget_queue_draw(widget);
+		return TRUE;
+	}
+	// + and - zoom about the middle of the drawing area, the arrow keys pan
+	// by a tenth of it
+	bool plain = !(event -> state & GDK_CONTROL_MASK);
+	guint key = event -> keyval;
+	double areaW = glob.screenWidth * 0.95, areaH = glob.screenHeight * 0.95;
+	if (plain && (key == GDK_KEY_plus || key == GDK_KEY_equal || key == GDK_KEY_KP_Add))
+	{
+		zoomView(1.25, areaW / 2.0, areaH / 2.0);
+		gtk_widget_queue_draw(widget);
+		return TRUE;
+	}
+	if (plain && (key == GDK_KEY_minus || key == GDK_KEY_KP_Subtract))
+	{
+		zoomView(1.0 / 1.25, areaW / 2.0, areaH / 2.0);
+		gtk_widget_queue_draw(widget);
+		return TRUE;
+	}
+	if (plain && (key == GDK_KEY_Left || key == GDK_KEY_Right || key == GDK_KEY_Up || key == GDK_KEY_Down))
+	{
+		double dx = (key == GDK_KEY_Left ? 1 : key == GDK_KEY_Right ? -1 : 0) * areaW / 10.0;
+		double dy = (key == GDK_KEY_Up ? 1 : key == GDK_KEY_Down ? -1 : 0) * areaH / 10.0;
+		panView(dx, dy);
+		gtk_widget_queue_draw(widget);
+		return TRUE;
+	}
+	// M switches the heatmap of the last run to its next metric
+	if (plain && key == GDK_KEY_m && heatmap.on)
+	{
+		heatmap.metric = (heatmap.metric + 1) % HEAT_METRICS;
+		printf("Heatmap: %s\n", HEAT_NAMES[heatmap.metric]);
+		// a tile the new metric has no value for yet (load needs two samples)
+		// goes back to its usual fill
+		for (int i = 0; i < (int)heatmap.color.size() && i < glob.count; i++)
+		{
+			heatmap.color[i] = heatColor(i);
+		}
+		gridLayer.stale = true;
+		gtk_widget_queue_draw(widget);
+		return TRUE;
+	}
+	// Ctrl+S saves the network, Ctrl+O replaces it with one from a file
+	if ((event -> state & GDK_CONTROL_MASK) && event -> keyval == GDK_KEY_s)
+	{
+		saveLayoutFile();
+		return TRUE;
+	}
+	if ((event -> state & GDK_CONTROL_MASK) && event -> keyval == GDK_KEY_o)
+	{
+		openLayoutFile();
+		gtk_widget_queue_draw(widget);
+		return TRUE;
+	}
+	// Ctrl+G replaces the network with a generated one
+	if ((event -> state & GDK_CONTROL_MASK) && event -> keyval == GDK_KEY_g)
+	{
+		generateGrid();
+		gtk_widget_queue_draw(widget);
+		return TRUE;
+	}
+	// Ctrl+T switches tracing on, and off again with the trace written out
+	if ((event -> state & GDK_CONTROL_MASK) && event -> keyval == GDK_KEY_t)
+	{
+		toggleTracing();
+		return TRUE;
+	}
+	return FALSE;
 }
 void addParams()
 {
+	glob.seriesCsv = gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(entryBoxes.seriesCsv));
+	glob.selfHealing = gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(entryBoxes.selfHealing));
+	glob.healStale = true;	// the drawn plan follows the new parameters
+	
 	// get the text from each entry box and add the text to the glob structure
 	try
 	{
@@ -913,15 +1952,260 @@ void addParams()
 		
 		// double
 		glob.transDist = stod(gtk_entry_get_text(GTK_ENTRY(entryBoxes.transceiverDist)));
+		glob.seriesInterval = stod(gtk_entry_get_text(GTK_ENTRY(entryBoxes.seriesInterval)));
+		glob.checkpointInterval = stod(gtk_entry_get_text(GTK_ENTRY(entryBoxes.checkpointInterval)));
 		
 		// strings
 		glob.simName = gtk_entry_get_text(GTK_ENTRY(entryBoxes.simulationSaveName));
+		
+		// last, since it is often left empty (one region)
+		glob.regions = max(1, stoi(gtk_entry_get_text(GTK_ENTRY(entryBoxes.regions))));
 	}
 	catch(const exception& ex)
 	{
 		cout << "Some values entered may not be valid; default parameters are substituted for these values" << endl;
 	}
 	
+	// a list ("3,4,6") or range ("80:200:40") in a parameter entry makes the run
+	// a sweep over its values; the parameter itself keeps the first value
+	glob.sweep.clear();
+	for (int i = 0; i < SWEEP_PARAMS; i++)
+	{
+		string text = gtk_entry_get_text(GTK_ENTRY(sweepEntry(SWEEP_NAMES[i])));
+		if (isSweepText(text))
+			glob.sweep.push_back(make_pair(string(SWEEP_NAMES[i]), text));
+	}
+}
+static GtkWidget* sweepEntry(const string& name)
+{
+	if (name == "bsLen")
+		return entryBoxes.baseStationSide;
+	if (name == "antNum")
+		return entryBoxes.antennaNumber;
+	if (name == "transNum")
+		return entryBoxes.transceiverNum;
+	if (name == "transDist")
+		return entryBoxes.transceiverDist;
+	if (name == "dRateMax")
+		return entryBoxes.maxDataRate;
+	if (name == "uePerAnt")
+		return entryBoxes.userEquipPerAntenna;
+	if (name == "bufSize")
+		return entryBoxes.bufferSize;
+	return NULL;
+}
+simTopology getSimTopology()
+{
+	updateConnectivity();
+	simTopology topo;
+	topo.state = glob.state;
+	topo.neighbors = glob.neighbors;
+	if (glob.selfHealing)
+	{
+		updateHealing();
+		applyHealing(glob.heal, topo);
+	}
+	return topo;
+}
+simParams getSimParams()
+{
+	simParams params;
+	params.bsLen = glob.bsLen;
+	params.antNum = glob.antNum;
+	params.transNum = glob.transNum;
+	params.transDist = glob.transDist;
+	params.dRateMax = glob.dRateMax;
+	params.uePerAnt = glob.uePerAnt;
+	params.simLen = glob.simLen;
+	params.bufSize = glob.bufSize;
+	params.selfHealing = glob.selfHealing;
+	return params;
+}
+static simLayout getSimLayout()
+{
+	simLayout layout;
+	layout.axial = glob.axial;
+	layout.state = glob.state;
+	layout.path = glob.path;
+	return layout;
+}
+static simSettings getSimSettings()
+{
+	simSettings settings;
+	settings.params = getSimParams();
+	settings.simName = glob.simName;
+	settings.simNum = glob.simNum;
+	settings.simStartNum = glob.simStartNum;
+	settings.series.interval = glob.seriesInterval;
+	settings.series.csv = glob.seriesCsv;
+	settings.series.checkpoint = glob.checkpointInterval;
+	settings.series.regions = glob.regions;
+	settings.sweep = glob.sweep;
+	return settings;
+}
+static void setSimSettings(const simSettings& settings)
+{
+	glob.bsLen = settings.params.bsLen;
+	glob.antNum = settings.params.antNum;
+	glob.transNum = settings.params.transNum;
+	glob.transDist = settings.params.transDist;
+	glob.dRateMax = settings.params.dRateMax;
+	glob.uePerAnt = settings.params.uePerAnt;
+	glob.simLen = settings.params.simLen;
+	glob.bufSize = settings.params.bufSize;
+	glob.selfHealing = settings.params.selfHealing;
+	glob.healStale = true;
+	glob.simName = settings.simName;
+	glob.simNum = settings.simNum;
+	glob.simStartNum = settings.simStartNum;
+	glob.seriesInterval = settings.series.interval;
+	glob.seriesCsv = settings.series.csv;
+	glob.checkpointInterval = settings.series.checkpoint;
+	glob.regions = settings.series.regions;
+	glob.sweep = settings.sweep;
+
+	// fill the entry boxes too, since addParams() reads them back before a run
+	gtk_entry_set_text(GTK_ENTRY(entryBoxes.baseStationSide), to_string(glob.bsLen).c_str());
+	gtk_entry_set_text(GTK_ENTRY(entryBoxes.antennaNumber), to_string(glob.antNum).c_str());
+	gtk_entry_set_text(GTK_ENTRY(entryBoxes.transceiverNum), to_string(glob.transNum).c_str());
+	gtk_entry_set_text(GTK_ENTRY(entryBoxes.maxDataRate), to_string(glob.dRateMax).c_str());
+	gtk_entry_set_text(GTK_ENTRY(entryBoxes.userEquipPerAntenna), to_string(glob.uePerAnt).c_str());
+	gtk_entry_set_text(GTK_ENTRY(entryBoxes.simulationLength), to_string(glob.simLen).c_str());
+	gtk_entry_set_text(GTK_ENTRY(entryBoxes.simulationNumber), to_string(glob.simNum).c_str());
+	gtk_entry_set_text(GTK_ENTRY(entryBoxes.simulationStart), to_string(glob.simStartNum).c_str());
+	gtk_entry_set_text(GTK_ENTRY(entryBoxes.bufferSize), to_string(glob.bufSize).c_str());
+	ostringstream dist;
+	dist << glob.transDist;
+	gtk_entry_set_text(GTK_ENTRY(entryBoxes.transceiverDist), dist.str().c_str());
+	gtk_entry_set_text(GTK_ENTRY(entryBoxes.simulationSaveName), glob.simName.c_str());
+	ostringstream interval;
+	interval << glob.seriesInterval;
+	gtk_entry_set_text(GTK_ENTRY(entryBoxes.seriesInterval), interval.str().c_str());
+	gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(entryBoxes.seriesCsv), glob.seriesCsv);
+	ostringstream checkpoint;
+	checkpoint << glob.checkpointInterval;
+	gtk_entry_set_text(GTK_ENTRY(entryBoxes.checkpointInterval), checkpoint.str().c_str());
+	gtk_entry_set_text(GTK_ENTRY(entryBoxes.regions), to_string(glob.regions).c_str());
+	gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(entryBoxes.selfHealing), glob.selfHealing);
+	for (int i = 0; i < (int)glob.sweep.size(); i++)
+	{
+		GtkWidget* entry = sweepEntry(glob.sweep[i].first);
+		if (entry != NULL)
+			gtk_entry_set_text(GTK_ENTRY(entry), glob.sweep[i].second.c_str());
+	}
+}
+static string chooseFile(bool save)
+{
+	GtkWidget *dialog = gtk_file_chooser_dialog_new(save ? "Save Layout" : "Open Layout", GTK_WINDOW(WINDOWS.DrawingWindow), save ? GTK_FILE_CHOOSER_ACTION_SAVE : GTK_FILE_CHOOSER_ACTION_OPEN, "_Cancel", GTK_RESPONSE_CANCEL, save ? "_Save" : "_Open", GTK_RESPONSE_ACCEPT, NULL);
+	if (save)
+	{
+		gtk_file_chooser_set_do_overwrite_confirmation(GTK_FILE_CHOOSER(dialog), TRUE);
+		gtk_file_chooser_set_current_name(GTK_FILE_CHOOSER(dialog), (glob.simName + ".shnl").c_str());
+	}
+	string fileName;
+	if (gtk_dialog_run(GTK_DIALOG(dialog)) == GTK_RESPONSE_ACCEPT)
+	{
+		char *chosen = gtk_file_chooser_get_filename(GTK_FILE_CHOOSER(dialog));
+		fileName = chosen;
+		g_free(chosen);
+	}
+	gtk_widget_destroy(dialog);
+	return fileName;
+}
+static void saveLayoutFile()
+{
+	string fileName = chooseFile(true);
+	if (fileName.empty() || glob.count == 0)
+		return;
+
+	// ".txt" files get the readable "q r state path" format, anything else the binary one
+	bool text = (fileName.size() > 4 && fileName.compare(fileName.size() - 4, 4, ".txt") == 0);
+	bool saved = (text ? saveLayoutText(fileName, getSimLayout()) : saveLayoutBinary(fileName, getSimLayout(), getSimSettings()));
+	if (saved)
+		printf("Saved %i tiles to %s\n", glob.count, fileName.c_str());
+}
+static void openLayoutFile()
+{
+	if (gridLocked())
+		return;
+	string fileName = chooseFile(false);
+	if (fileName.empty())
+		return;
+
+	simLayout layout;
+	if (isLayoutBinary(fileName))
+	{
+		mappedLayout mapped;
+		if (!mapLayout(fileName, mapped))
+			return;
+		const layoutView& view = mapped.view;
+		layout.axial.resize(view.tiles);
+		for (int i = 0; i < view.tiles; i++)
+		{
+			layout.axial[i] = make_pair((int)view.q[i], (int)view.r[i]);
+		}
+		layout.state.assign(view.state, view.state + view.tiles);
+		layout.path.assign(view.path, view.path + view.tiles);
+		setSimSettings(mapped.settings);
+		unmapLayout(mapped);
+	}
+	else if (!loadLayoutText(fileName, layout))
+	{
+		return;
+	}
+	if (layout.axial.empty())
+	{
+		printf("%s holds no tiles\n", fileName.c_str());
+		return;
+	}
+	useLayout(layout);
+	printf("Opened %i tiles from %s\n", glob.count, fileName.c_str());
+}
+static void generateGrid()
+{
+	// the spec typed last time is offered again
+	static string spec = "rings:10";
+	if (gridLocked())
+		return;
+	GtkWidget *dialog = gtk_dialog_new_with_buttons("Generate Network", GTK_WINDOW(WINDOWS.DrawingWindow), GTK_DIALOG_MODAL, "_Cancel", GTK_RESPONSE_CANCEL, "_Generate", GTK_RESPONSE_ACCEPT, NULL);
+	GtkWidget *hint = gtk_label_new("rings:<n>, rect:<width>x<height> or random:<tiles>\nfollowed by ,seed=  ,congested=  ,alt=  ,down=  ,clusters=\ne.g. random:20000,seed=3,down=0.02,congested=0.1,clusters=4");
+	GtkWidget *specTxt = gtk_entry_new();
+	gtk_entry_set_text(GTK_ENTRY(specTxt), spec.c_str());
+	gtk_entry_set_activates_default(GTK_ENTRY(specTxt), TRUE);
+	gtk_dialog_set_default_response(GTK_DIALOG(dialog), GTK_RESPONSE_ACCEPT);
+	GtkWidget *content = gtk_dialog_get_content_area(GTK_DIALOG(dialog));
+	gtk_box_pack_start(GTK_BOX(content), hint, 0, 0, 5);
+	gtk_box_pack_start(GTK_BOX(content), specTxt, 0, 0, 5);
+	gtk_widget_show_all(dialog);
+
+	gridOptions options;
+	bool accepted = (gtk_dialog_run(GTK_DIALOG(dialog)) == GTK_RESPONSE_ACCEPT);
+	if (accepted)
+		spec = gtk_entry_get_text(GTK_ENTRY(specTxt));
+	gtk_widget_destroy(dialog);
+	if (!accepted || !parseGridSpec(spec, options))
+		return;
+
+	useLayout(generateLayout(options));
+	printf("Generated %i tiles from \"%s\"\n", glob.count, spec.c_str());
+}
+static void useLayout(const simLayout& layout)
+{
+	// replace the network being drawn
+	glob.axial = layout.axial;
+	glob.state = layout.state;
+	glob.path = layout.path;
+	glob.count = (int)glob.axial.size();
+	glob.selectedTile = 0;
+	indexTiles();
+	computeBounds();
+	fitView();
+
+	// the heatmap of the last run belongs to the old network
+	heatmap.on = false;
+	heatmap.pending.clear();
+	heatmap.isPending.clear();
+	gridLayer.stale = true;
 }
 void getDimensions()
 {
@@ -0,0 +1,270 @@
+#include "SHNSim_Generate.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <algorithm>
+#include <sstream>
+
+using namespace std;
+
+// splitmix64; only grid generation uses it, runs draw from the per-tile
+// streams of SHNSim_Random.h
+static unsigned long long nextRandom(unsigned long long& state)
+{
+	unsigned long long z = (state += 0x9E3779B97F4A7C15ULL);
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+	return z ^ (z >> 31);
+}
+
+static int randomBelow(unsigned long long& state, int n)
+{
+	return (int)(nextRandom(state) % (unsigned long long)n);
+}
+
+static long long shapeTiles(const gridOptions& options)
+{
+	if (options.shape == GRID_RINGS)
+		return 3LL * options.rings * (options.rings + 1) + 1;
+	if (options.shape == GRID_RECTANGLE)
+		return (long long)options.width * options.height;
+	return options.tiles;
+}
+
+static bool parseNumber(const string& text, double& value)
+{
+	char* end;
+	value = strtod(text.c_str(), &end);
+	return !text.empty() && *end == '\0';
+}
+
+bool parseGridSpec(const string& spec, gridOptions& options)
+{
+	gridOptions parsed;
+	size_t colon = spec.find(':');
+	string shape = spec.substr(0, colon);
+	string rest = (colon == string::npos ? "" : spec.substr(colon + 1));
+	string size = rest.substr(0, rest.find(','));
+	char extra;
+	bool ok;
+	if (shape == "rings")
+	{
+		parsed.shape = GRID_RINGS;
+		ok = (sscanf(size.c_str(), "%d%c", &parsed.rings, &extra) == 1 && parsed.rings >= 0);
+	}
+	else if (shape == "rect")
+	{
+		parsed.shape = GRID_RECTANGLE;
+		ok = (sscanf(size.c_str(), "%dx%d%c", &parsed.width, &parsed.height, &extra) == 2 && parsed.width > 0 && parsed.height > 0);
+	}
+	else if (shape == "random")
+	{
+		parsed.shape = GRID_RANDOM;
+		ok = (sscanf(size.c_str(), "%d%c", &parsed.tiles, &extra) == 1 && parsed.tiles > 0);
+	}
+	else
+	{
+		ok = false;
+	}
+	if (!ok)
+	{
+		printf("\"%s\": expected rings:<n>, rect:<width>x<height> or random:<tiles>\n", spec.c_str());
+		return false;
+	}
+	if (shapeTiles(parsed) > GRID_MAX_TILES)
+	{
+		printf("\"%s\": more than %i tiles\n", spec.c_str(), GRID_MAX_TILES);
+		return false;
+	}
+
+	stringstream fields(rest.find(',') == string::npos ? "" : rest.substr(rest.find(',') + 1));
+	string field;
+	while (getline(fields, field, ','))
+	{
+		size_t equals = field.find('=');
+		string name = field.substr(0, equals);
+		double value;
+		if (equals == string::npos || !parseNumber(field.substr(equals + 1), value))
+		{
+			printf("\"%s\": expected name=value, not \"%s\"\n", spec.c_str(), field.c_str());
+			return false;
+		}
+		bool fraction = (value >= 0 && value <= 1);
+		if (name == "seed" && value >= 0)
+			parsed.seed = (unsigned long long)value;
+		else if (name == "congested" && fraction)
+			parsed.congested = value;
+		else if (name == "alt" && fraction)
+			parsed.altCongested = value;
+		else if (name == "down" && fraction)
+			parsed.down = value;
+		else if (name == "clusters" && value >= 0 && value == floor(value))
+			parsed.clusters = (int)value;
+		else
+		{
+			printf("\"%s\": unknown name or bad value in \"%s\" (seed, congested, alt, down and clusters; fractions are 0-1)\n", spec.c_str(), field.c_str());
+			return false;
+		}
+	}
+	options = parsed;
+	return true;
+}
+
+// path code of a tile placed at axial offset (dq, dr) from the selected tile,
+// indexed by the hexSide() of the offset (the codes mouse_clicked() stores)
+static const int placeCode[6] = {5, 0, 2, 1, 3, 4};
+
+static void placementPaths(simLayout& layout)
+{
+	unordered_map<long long, int> index;
+	indexLayout(layout.axial, index);
+	int tiles = (int)layout.axial.size();
+	layout.path.assign(tiles, 7);
+	for (int i = 1; i < tiles; i++)
+	{
+		for (int k = 0; k < 6; k++)
+		{
+			int n = findCell(index, layout.axial[i].first - hexDir[k][0], layout.axial[i].second - hexDir[k][1]);
+			if (n != -1 && n < i)
+			{
+				layout.path[i - 1] = placeCode[k];
+				break;
+			}
+		}
+	}
+}
+
+static void ringCells(int rings, vector<pair<int, int>>& axial)
+{
+	// each ring starts "ring" steps out in direction 4, next to the start of
+	// the ring inside it, and walks its six sides
+	static const int walk[6] = {0, 1, 3, 2, 4, 5};
+	axial.push_back(make_pair(0, 0));
+	for (int ring = 1; ring <= rings; ring++)
+	{
+		int q = hexDir[4][0] * ring, r = hexDir[4][1] * ring;
+		for (int k = 0; k < 6; k++)
+		{
+			for (int j = 0; j < ring; j++)
+			{
+				axial.push_back(make_pair(q, r));
+				q += hexDir[walk[k]][0];
+				r += hexDir[walk[k]][1];
+			}
+		}
+	}
+}
+
+static void rectangleCells(int width, int height, vector<pair<int, int>>& axial)
+{
+	// column q is shifted up by q / 2 rows, so odd columns sit half a tile lower
+	for (int q = 0; q < width; q++)
+	{
+		for (int row = 0; row < height; row++)
+		{
+			axial.push_back(make_pair(q, row - q / 2));
+		}
+	}
+}
+
+static void randomCells(int tiles, unsigned long long& rng, vector<pair<int, int>>& axial)
+{
+	// grow from (0,0), adding a random cell of the frontier every step; the
+	// frontier may hold a cell more than once, which favors cells touching
+	// several tiles and keeps the network compact
+	unordered_map<long long, int> index;
+	vector<pair<int, int>> frontier = {make_pair(0, 0)};
+	while ((int)axial.size() < tiles)
+	{
+		int j = randomBelow(rng, (int)frontier.size());
+		pair<int, int> cell = frontier[j];
+		frontier[j] = frontier.back();
+		frontier.pop_back();
+		if (!index.emplace(hexKey(cell.first, cell.second), (int)axial.size()).second)
+			continue;
+		axial.push_back(cell);
+		for (int k = 0; k < 6; k++)
+		{
+			int q = cell.first + hexDir[k][0], r = cell.second + hexDir[k][1];
+			if (findCell(index, q, r) == -1)
+				frontier.push_back(make_pair(q, r));
+		}
+	}
+}
+
+simLayout generateLayout(const gridOptions& options)
+{
+	simLayout layout;
+	unsigned long long rng = options.seed;
+	if (options.shape == GRID_RINGS)
+		ringCells(options.rings, layout.axial);
+	else if (options.shape == GRID_RECTANGLE)
+		rectangleCells(options.width, options.height, layout.axial);
+	else
+		randomCells(options.tiles, rng, layout.axial);
+	placementPaths(layout);
+	generateFailures(layout, options);
+	return layout;
+}
+
+void generateFailures(simLayout& layout, const gridOptions& options)
+{
+	int tiles = (int)layout.axial.size();
+	layout.state.assign(tiles, 0);
+	if (tiles == 0)
+		return;
+
+	// the failure stream does not depend on how the cells were generated
+	unsigned long long rng = options.seed ^ 0x5DEECE66DULL;
+	vector<int> order(tiles);
+	for (int i = 0; i < tiles; i++)
+	{
+		order[i] = i;
+	}
+	for (int i = tiles - 1; i > 0; i--)
+	{
+		swap(order[i], order[randomBelow(rng, i + 1)]);
+	}
+
+	// clustered: breadth first from the first "clusters" tiles of the shuffle,
+	// so tiles fail in order of their distance to the nearest cluster center
+	if (options.clusters > 0)
+	{
+		simTopology topo = layoutTopology(layout);
+		vector<char> seen(tiles, 0);
+		vector<int> visit;
+		visit.reserve(tiles);
+		for (int i = 0; i < min(options.clusters, tiles); i++)
+		{
+			seen[order[i]] = 1;
+			visit.push_back(order[i]);
+		}
+		for (int head = 0; head < (int)visit.size(); head++)
+		{
+			const vector<pair<int, int>>& next = topo.neighbors[visit[head]];
+			for (int i = 0; i < (int)next.size(); i++)
+			{
+				if (!seen[next[i].first])
+				{
+					seen[next[i].first] = 1;
+					visit.push_back(next[i].first);
+				}
+			}
+		}
+		// tiles not connected to any center fail last
+		for (int i = 0; i < tiles; i++)
+		{
+			if (!seen[order[i]])
+				visit.push_back(order[i]);
+		}
+		order.swap(visit);
+	}
+
+	int down = (int)llround(options.down * tiles);
+	int congested = min(tiles - down, (int)llround(options.congested * tiles));
+	int altCongested = min(tiles - down - congested, (int)llround(options.altCongested * tiles));
+	for (int i = 0; i < down + congested + altCongested; i++)
+	{
+		layout.state[order[i]] = (i < down ? 3 : (i < down + congested ? 1 : 2));
+	}
+}
@@ -0,0 +1,47 @@
+#ifndef SHNSIM_GENERATE_H
+#define SHNSIM_GENERATE_H
+
+#include <string>
+#include "SHNSim_Layout.h"
+
+// Generated networks for stress tests. Tiles are numbered so that every tile
+// after the first touches an earlier one, the order in which they could have
+// been placed by clicking; the path codes record that placement
+enum gridShape
+{
+	GRID_RINGS,	// center tile and "rings" full rings around it, 3 * rings * (rings + 1) + 1 tiles
+	GRID_RECTANGLE,	// "width" columns of "height" tiles, rectangular on screen
+	GRID_RANDOM	// "tiles" tiles grown from (0,0) by adding random free neighbors
+};
+
+struct gridOptions
+{
+	gridShape shape = GRID_RINGS;
+	int rings = 10;
+	int width = 100, height = 100;
+	int tiles = 10000;
+	unsigned long long seed = 1;
+
+	// fractions of the tiles that fail; "clusters" > 0 gathers the failures
+	// around that many random tiles (down tiles in the middle, congested ones
+	// around them), 0 spreads them uniformly
+	double congested = 0, altCongested = 0, down = 0;
+	int clusters = 0;
+};
+
+// largest network generateLayout() builds
+static const int GRID_MAX_TILES = 10000000;
+
+// "<shape>:<size>[,name=value...]", shape and size being rings:<n>,
+// rect:<width>x<height> or random:<tiles>, and the names seed, congested, alt,
+// down and clusters, e.g. "random:20000,seed=3,down=0.02,congested=0.1,clusters=4".
+// Fails (with a message on stdout) on anything else or on more than
+// GRID_MAX_TILES tiles
+bool parseGridSpec(const std::string& spec, gridOptions& options);
+
+simLayout generateLayout(const gridOptions& options);
+
+// set the failure pattern of "options" on a layout (all other tiles healthy)
+void generateFailures(simLayout& layout, const gridOptions& options);
+
+#endif
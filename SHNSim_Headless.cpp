@@ -0,0 +1,157 @@
+// build: g++ -O2 -pthread -o SHNSim_Headless SHNSim_Headless.cpp SHNSim_Layout.cpp SHNSim_Engine.cpp SHNSim_Batch.cpp SHNSim_Results.cpp SHNSim_Healing.cpp SHNSim_Trace.cpp SHNSim_Generate.cpp SHNSim_Checkpoint.cpp SHNSim_Sweep.cpp SHNSim_Random.cpp SHNSim_Regions.cpp
+//
+// runs a batch without GTK, for machines without a display:
+//     SHNSim_Headless <layout file | grid spec> [settings file] [threads]
+// the layout file is either a binary layout saved from the GUI (mapped, with its
+// parameter block used as the settings) or a text file with one "q r state path"
+// line per tile; a grid spec such as "rings:60,down=0.02" generates the network
+// instead (see SHNSim_Generate.h); the settings file has one "name value" line
+// per parameter window field and overrides the saved parameters (see
+// SHNSim_Layout.h);
+// results go to the same "<simName>_<run>.csv" files the GUI writes, and the
+// time series (if seriesInterval is set) to "<simName>_<run>_series.bin/.csv";
+// with SHNSIM_TRACE=<file> in the environment a Chrome trace of the batch is
+// written to that file; with checkpointInterval set, runs take snapshots
+// ("<simName>_<run>.ckpt") and a run that was interrupted resumes from its
+// snapshot when the same batch is started again; "sweep" lines in the settings
+// file run a parameter sweep instead, summarized in "<simName>_sweep.csv" (time
+// series, snapshots and regions are refused with a sweep);
+// "regions n" splits every run into n regions on threads of their own (see
+// SHNSim_Regions.h)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <sstream>
+#include "SHNSim_Engine.h"
+#include "SHNSim_Batch.h"
+#include "SHNSim_Layout.h"
+#include "SHNSim_Healing.h"
+#include "SHNSim_Trace.h"
+#include "SHNSim_Generate.h"
+#include "SHNSim_Sweep.h"
+#include <unistd.h>
+
+using namespace std;
+
+static void exportTrace(const char* traceFile)
+{
+	if (traceFile != NULL && traceExport(traceFile))
+		printf("Trace written to %s\n", traceFile);
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 2 || argc > 4)
+	{
+		printf("usage: %s <layout file | grid spec> [settings file] [threads]\n", argv[0]);
+		return 2;
+	}
+
+	simTopology topo;
+	simSettings settings;
+	gridOptions grid;
+	if (access(argv[1], F_OK) != 0 && string(argv[1]).find(':') != string::npos)
+	{
+		if (!parseGridSpec(argv[1], grid))
+			return 1;
+		topo = layoutTopology(generateLayout(grid));
+	}
+	else if (isLayoutBinary(argv[1]))
+	{
+		mappedLayout mapped;
+		if (!mapLayout(argv[1], mapped))
+			return 1;
+		topo = viewTopology(mapped.view);
+		settings = mapped.settings;
+		unmapLayout(mapped);
+	}
+	else
+	{
+		simLayout layout;
+		if (!loadLayoutText(argv[1], layout))
+			return 1;
+		topo = layoutTopology(layout);
+	}
+	if (topo.state.empty())
+	{
+		printf("%s holds no tiles\n", argv[1]);
+		return 1;
+	}
+
+	if (argc > 2 && !loadSettingsText(argv[2], settings))
+		return 1;
+	int threads = (argc > 3 ? atoi(argv[3]) : 0);
+	const char* traceFile = getenv("SHNSIM_TRACE");
+	if (traceFile != NULL)
+	{
+		traceSetEnabled(true);
+		traceThreadName("main");
+	}
+
+	vector<sweepAxis> axes;
+	if (!sweepAxes(settings.sweep, axes))
+		return 1;
+	if (!axes.empty() && !checkSweepOptions(settings.series))
+		return 1;
+	if (!axes.empty())
+	{
+		vector<simParams> points = sweepPoints(settings.params, axes);
+		printf("%i tiles, sweep of %i points x runs %i .. %i\n", (int)topo.state.size(), (int)points.size(), settings.simStartNum, settings.simStartNum + settings.simNum - 1);
+		vector<sweepResult> results = runSweep(topo, points, settings.simName, settings.simStartNum, settings.simNum, threads);
+		int cached = 0;
+		for (int i = 0; i < (int)results.size(); i++)
+		{
+			const sweepResult& r = results[i];
+			const tileStats& total = r.summary.total;
+			string point;
+			for (int a = 0; a < (int)axes.size(); a++)
+			{
+				ostringstream value;
+				value << (a > 0 ? ", " : "") << axes[a].name << " " << sweepValue(points[r.point], axes[a].name);
+				point += value.str();
+			}
+			printf("Point %i (%s) run %i: %lld generated, %lld served, %lld dropped, %lld blocked, mean delay %f s%s\n", r.point, point.c_str(), r.summary.run, total.arrivals, total.served, total.dropped, total.blocked, (total.served > 0 ? total.delaySum / total.served : 0.0), (r.cached ? " (cached)" : ""));
+			cached += r.cached;
+		}
+		printf("Sweep: %i runs simulated, %i taken from %s/ -> %s_sweep.csv\n", (int)results.size() - cached, cached, SWEEP_CACHE_DIR, settings.simName.c_str());
+		exportTrace(traceFile);
+		return 0;
+	}
+
+	if (settings.params.selfHealing)
+	{
+		healPlan plan;
+		initHealing(plan, topo, settings.params);
+		applyHealing(plan, topo);
+		int donors = 0;
+		double unserved = 0;
+		for (int t = 0; t < (int)topo.state.size(); t++)
+		{
+			donors += !plan.moves[t].empty();
+			unserved += unservedLoad(plan, t);
+		}
+		printf("Self-healing: %i tiles hand over UEs, %.0f packets/s left unserved\n", donors, unserved);
+	}
+
+	printf("%i tiles, runs %i .. %i on %i threads\n", (int)topo.state.size(), settings.simStartNum, settings.simStartNum + settings.simNum - 1, batchThreads(threads, settings.simNum, settings.series.regions));
+	if (settings.series.regions > 1)
+		printf("Every run split into %i regions\n", min(settings.series.regions, (int)topo.state.size()));
+	vector<runSummary> runs = runBatch(topo, settings.params, settings.simName, settings.simStartNum, settings.simNum, threads, NULL, settings.series);
+
+	long long events = 0, allocations = 0;
+	double wallSeconds = 0;
+	for (int i = 0; i < (int)runs.size(); i++)
+	{
+		const tileStats& total = runs[i].total;
+		printf("Run %i: %lld generated, %lld served, %lld dropped, %lld blocked, mean delay %f s -> %s\n", runs[i].run, total.arrivals, total.served, total.dropped, total.blocked, (total.served > 0 ? total.delaySum / total.served : 0.0), runFileName(settings.simName, runs[i].run).c_str());
+		events += runs[i].events;
+		wallSeconds += runs[i].wallSeconds;
+		allocations += runs[i].allocations;
+	}
+	printf("Simulated %i x %i s: %lld events in %.3f engine seconds (%.0f events/s per thread), %lld heap allocations in the event loop\n", (int)runs.size(), settings.params.simLen, events, wallSeconds, events / max(wallSeconds, 1e-9), allocations);
+	exportTrace(traceFile);
+	return 0;
+}
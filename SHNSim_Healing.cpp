@@ -0,0 +1,175 @@
+#include "SHNSim_Healing.h"
+#include <algorithm>
+
+using namespace std;
+
+static double tileDemand(const simParams& params, int state)
+{
+	// UE rates are uniform on [1, dRateMax]
+	int sets = (state == 1 || state == 2 ? 2 : 1);
+	return max(1, params.antNum) * max(0, params.uePerAnt) * sets * (1.0 + max(1, params.dRateMax)) / 2.0;
+}
+
+static double tileCapacity(const simParams& params, int state)
+{
+	if (state == 3)
+		return 0;
+	return max(1, params.antNum) * (double)max(1, params.dRateMax * params.uePerAnt);
+}
+
+static double excess(const healPlan& plan, int tile)
+{
+	return max(0.0, plan.demand[tile] - plan.capacity[tile]);
+}
+
+// spare capacity a healthy tile offers to each donor next to it
+static double offer(const healPlan& plan, int tile)
+{
+	if (plan.state[tile] != 0 || plan.donors[tile] == 0)
+		return 0;
+	return max(0.0, plan.capacity[tile] - plan.demand[tile]) / plan.donors[tile];
+}
+
+// drop the donor's old handovers and hand its excess to its neighbors again
+static void planDonor(healPlan& plan, const vector<vector<pair<int, int>>>& neighbors, int donor)
+{
+	vector<handover>& moves = plan.moves[donor];
+	for (int i = 0; i < (int)moves.size(); i++)
+	{
+		plan.load[moves[i].tile] -= moves[i].moved;
+		plan.load[donor] += moves[i].moved;
+	}
+	moves.clear();
+
+	double need = excess(plan, donor);
+	if (need <= 0)
+		return;
+	plan.replanned++;
+
+	double offered = 0;
+	for (int i = 0; i < (int)neighbors[donor].size(); i++)
+	{
+		offered += offer(plan, neighbors[donor][i].first);
+	}
+	if (offered <= 0)
+		return;
+
+	// every neighbor gives the same part of its offer
+	double scale = min(1.0, need / offered);
+	for (int i = 0; i < (int)neighbors[donor].size(); i++)
+	{
+		int tile = neighbors[donor][i].first;
+		double moved = offer(plan, tile) * scale;
+		if (moved <= 0)
+			continue;
+		handover h = {tile, neighbors[donor][i].second, moved / plan.demand[donor], moved};
+		moves.push_back(h);
+		plan.load[tile] += moved;
+		plan.load[donor] -= moved;
+	}
+}
+
+void initHealing(healPlan& plan, const simTopology& topo, const simParams& params)
+{
+	int tiles = (int)topo.state.size();
+	plan.params = params;
+	plan.state = topo.state;
+	plan.demand.resize(tiles);
+	plan.capacity.resize(tiles);
+	plan.donors.assign(tiles, 0);
+	plan.moves.assign(tiles, vector<handover>());
+	plan.seen.assign(tiles, 0);
+	plan.stamp = 0;
+	plan.replanned = 0;
+	for (int t = 0; t < tiles; t++)
+	{
+		plan.demand[t] = tileDemand(params, plan.state[t]);
+		plan.capacity[t] = tileCapacity(params, plan.state[t]);
+	}
+	plan.load = plan.demand;
+
+	for (int t = 0; t < tiles; t++)
+	{
+		if (excess(plan, t) > 0)
+		{
+			for (int i = 0; i < (int)topo.neighbors[t].size(); i++)
+			{
+				plan.donors[topo.neighbors[t][i].first]++;
+			}
+		}
+	}
+	for (int t = 0; t < tiles; t++)
+	{
+		if (excess(plan, t) > 0)
+			planDonor(plan, topo.neighbors, t);
+	}
+}
+
+void setHealingState(healPlan& plan, const vector<vector<pair<int, int>>>& neighbors, int tile, int state)
+{
+	bool wasDonor = (excess(plan, tile) > 0);
+	double oldDemand = plan.demand[tile];
+	plan.state[tile] = state;
+	plan.demand[tile] = tileDemand(plan.params, state);
+	plan.capacity[tile] = tileCapacity(plan.params, state);
+	plan.load[tile] += plan.demand[tile] - oldDemand;
+
+	bool isDonor = (excess(plan, tile) > 0);
+	if (isDonor != wasDonor)
+	{
+		for (int i = 0; i < (int)neighbors[tile].size(); i++)
+		{
+			plan.donors[neighbors[tile][i].first] += (isDonor ? 1 : -1);
+		}
+	}
+
+	// a donor's plan reads its neighbors' offers, which read their neighbors'
+	// donor counts, so everything within two steps of the tile is re-planned
+	// (donors, and former donors that still hold handovers)
+	if (++plan.stamp == 0)
+	{
+		plan.seen.assign(plan.seen.size(), 0);
+		plan.stamp = 1;
+	}
+	vector<int> ring = {tile}, next;
+	plan.seen[tile] = plan.stamp;
+	for (int step = 0; step <= 2; step++)
+	{
+		for (int i = 0; i < (int)ring.size(); i++)
+		{
+			int t = ring[i];
+			if (excess(plan, t) > 0 || !plan.moves[t].empty())
+				planDonor(plan, neighbors, t);
+			if (step == 2)
+				continue;
+			for (int j = 0; j < (int)neighbors[t].size(); j++)
+			{
+				int n = neighbors[t][j].first;
+				if (plan.seen[n] != plan.stamp)
+				{
+					plan.seen[n] = plan.stamp;
+					next.push_back(n);
+				}
+			}
+		}
+		ring.swap(next);
+		next.clear();
+	}
+}
+
+double unservedLoad(const healPlan& plan, int tile)
+{
+	return max(0.0, plan.load[tile] - plan.capacity[tile]);
+}
+
+void applyHealing(const healPlan& plan, simTopology& topo)
+{
+	topo.handover.assign(plan.moves.size(), vector<pair<int, double>>());
+	for (int t = 0; t < (int)plan.moves.size(); t++)
+	{
+		for (int i = 0; i < (int)plan.moves[t].size(); i++)
+		{
+			topo.handover[t].push_back(make_pair(plan.moves[t][i].tile, plan.moves[t][i].share));
+		}
+	}
+}
@@ -0,0 +1,55 @@
+#ifndef SHNSIM_HEALING_H
+#define SHNSIM_HEALING_H
+
+#include <vector>
+#include <utility>
+#include "SHNSim_Engine.h"
+
+// Self-healing model
+//  - every tile offers the mean load of its own UEs (congested and alt congested
+//    tiles count their extra UE set) and can serve dRateMax * uePerAnt packets
+//    per second per antenna; a down tile (state 3) serves nothing
+//  - a tile whose load exceeds its capacity is a donor: the excess is handed
+//    over to healthy neighbors, across the sides in its neighbor list
+//  - a healthy tile splits its spare capacity evenly between the donors next to
+//    it, so no tile is ever promised more than it has spare; whatever its
+//    neighbors cannot take stays unserved
+// A donor's handovers only depend on tiles up to two steps away, so changing
+// the state of one tile re-plans at most the 19 tiles around it
+
+// part of a donor's UEs moved to the neighbor across "side"
+struct handover
+{
+	int tile;
+	int side;
+	double share;	// fraction of the donor's own UEs
+	double moved;	// packets/s
+};
+
+struct healPlan
+{
+	simParams params;
+	std::vector<int> state;
+	std::vector<double> demand;	// packets/s offered by the tile's own UEs
+	std::vector<double> capacity;	// packets/s its antennas can serve
+	std::vector<double> load;	// packets/s it carries after the handovers
+	std::vector<int> donors;	// number of donors next to the tile
+	std::vector<std::vector<handover>> moves;	// handovers of every donor
+	std::vector<int> seen;	// visit stamps of the local re-planning walk
+	int stamp = 0;
+	long long replanned = 0;	// donors planned since initHealing()
+};
+
+// plan every tile of a network from scratch
+void initHealing(healPlan& plan, const simTopology& topo, const simParams& params);
+
+// change the state of one tile and re-plan only the donors it can affect
+void setHealingState(healPlan& plan, const std::vector<std::vector<std::pair<int, int>>>& neighbors, int tile, int state);
+
+// packets/s the tile cannot serve after the handovers
+double unservedLoad(const healPlan& plan, int tile);
+
+// copy the handovers into a topology, so the simulation moves the UEs
+void applyHealing(const healPlan& plan, simTopology& topo);
+
+#endif
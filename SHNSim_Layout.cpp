@@ -0,0 +1,392 @@
+#include "SHNSim_Layout.h"
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fstream>
+#include <sstream>
+
+using namespace std;
+
+const int hexDir[6][2] = {{1, 0}, {0, 1}, {-1, 0}, {-1, 1}, {0, -1}, {1, -1}};
+
+int hexSide(int dq, int dr)
+{
+	// side numbers by axial offset, stored as [dq + 1][dr + 1]
+	static const int sides[3][3] = {{-1, 2, 3}, {4, -1, 1}, {5, 0, -1}};
+	if (dq < -1 || dq > 1 || dr < -1 || dr > 1)
+		return -1;
+	return sides[dq + 1][dr + 1];
+}
+
+long long hexKey(int q, int r)
+{
+	return ((long long)q << 32) | (unsigned int)r;
+}
+
+void indexLayout(const vector<pair<int, int>>& axial, unordered_map<long long, int>& index)
+{
+	index.clear();
+	index.reserve(axial.size());
+	for (int i = 0; i < (int)axial.size(); i++)
+	{
+		index[hexKey(axial[i].first, axial[i].second)] = i;
+	}
+}
+
+int findCell(const unordered_map<long long, int>& index, int q, int r)
+{
+	unordered_map<long long, int>::const_iterator it = index.find(hexKey(q, r));
+	return (it == index.end() ? -1 : it->second);
+}
+
+// shared by the vector and the mapped layouts; q(n) and r(n) give the cell of tile n
+template <class Q, class R>
+static void neighborsOf(int tiles, Q q, R r, const unordered_map<long long, int>& index, vector<vector<pair<int, int>>>& neighbors)
+{
+	neighbors.assign(tiles, vector<pair<int, int>>());
+	for (int n = 0; n < tiles; n++)
+	{
+		for (int k = 0; k < 6; k++)
+		{
+			int i = findCell(index, q(n) + hexDir[k][0], r(n) + hexDir[k][1]);
+			if (i != -1)
+			{
+				neighbors[n].push_back(make_pair(i, k));
+			}
+		}
+	}
+}
+
+void buildNeighbors(const vector<pair<int, int>>& axial, const unordered_map<long long, int>& index, vector<vector<pair<int, int>>>& neighbors)
+{
+	neighborsOf((int)axial.size(), [&](int n) { return axial[n].first; }, [&](int n) { return axial[n].second; }, index, neighbors);
+}
+
+simTopology layoutTopology(const simLayout& layout)
+{
+	unordered_map<long long, int> index;
+	indexLayout(layout.axial, index);
+	simTopology topo;
+	topo.state = layout.state;
+	buildNeighbors(layout.axial, index, topo.neighbors);
+	return topo;
+}
+
+bool loadLayoutText(const string& fileName, simLayout& layout)
+{
+	ifstream in(fileName.c_str());
+	if (!in)
+	{
+		printf("Could not open %s for reading\n", fileName.c_str());
+		return false;
+	}
+
+	layout = simLayout();
+	unordered_map<long long, int> index;
+	string line;
+	for (int lineNum = 1; getline(in, line); lineNum++)
+	{
+		line = line.substr(0, line.find('#'));
+		istringstream fields(line);
+		int q, r, state, path;
+		if (!(fields >> q))
+			continue;	// blank or comment line
+		string rest;
+		if (!(fields >> r >> state >> path) || (fields >> rest) || state < 0 || state > 3)
+		{
+			printf("%s:%i: expected \"q r state path\" with state 0-3\n", fileName.c_str(), lineNum);
+			return false;
+		}
+		if (!index.insert(make_pair(hexKey(q, r), (int)layout.axial.size())).second)
+		{
+			printf("%s:%i: cell (%i, %i) holds more than one tile\n", fileName.c_str(), lineNum, q, r);
+			return false;
+		}
+		layout.axial.push_back(make_pair(q, r));
+		layout.state.push_back(state);
+		layout.path.push_back(path);
+	}
+	return true;
+}
+
+bool saveLayoutText(const string& fileName, const simLayout& layout)
+{
+	FILE* out = fopen(fileName.c_str(), "w");
+	if (out == NULL)
+	{
+		printf("Could not open %s for writing\n", fileName.c_str());
+		return false;
+	}
+	fprintf(out, "# q r state path\n");
+	for (int i = 0; i < (int)layout.axial.size(); i++)
+	{
+		fprintf(out, "%i %i %i %i\n", layout.axial[i].first, layout.axial[i].second, layout.state[i], layout.path[i]);
+	}
+	fclose(out);
+	return true;
+}
+
+bool loadSettingsText(const string& fileName, simSettings& settings)
+{
+	ifstream in(fileName.c_str());
+	if (!in)
+	{
+		printf("Could not open %s for reading\n", fileName.c_str());
+		return false;
+	}
+
+	string line;
+	for (int lineNum = 1; getline(in, line); lineNum++)
+	{
+		line = line.substr(0, line.find('#'));
+		istringstream fields(line);
+		string name, rest;
+		if (!(fields >> name))
+			continue;	// blank or comment line
+
+		bool ok;
+		simParams& p = settings.params;
+		if (name == "bsLen") ok = (bool)(fields >> p.bsLen);
+		else if (name == "antNum") ok = (bool)(fields >> p.antNum);
+		else if (name == "transNum") ok = (bool)(fields >> p.transNum);
+		else if (name == "transDist") ok = (bool)(fields >> p.transDist);
+		else if (name == "dRateMax") ok = (bool)(fields >> p.dRateMax);
+		else if (name == "uePerAnt") ok = (bool)(fields >> p.uePerAnt);
+		else if (name == "simLen") ok = (bool)(fields >> p.simLen);
+		else if (name == "bufSize") ok = (bool)(fields >> p.bufSize);
+		else if (name == "selfHealing") ok = (bool)(fields >> p.selfHealing);
+		else if (name == "simNum") ok = (bool)(fields >> settings.simNum);
+		else if (name == "simStartNum") ok = (bool)(fields >> settings.simStartNum);
+		else if (name == "seriesInterval") ok = (bool)(fields >> settings.series.interval);
+		else if (name == "seriesCsv") ok = (bool)(fields >> settings.series.csv);
+		else if (name == "checkpointInterval") ok = (bool)(fields >> settings.series.checkpoint);
+		else if (name == "regions") ok = (bool)(fields >> settings.series.regions);
+		else if (name == "sweep")
+		{
+			pair<string, string> axis;
+			ok = (bool)(fields >> axis.first >> axis.second);
+			settings.sweep.push_back(axis);
+		}
+		else if (name == "simName")
+		{
+			// the name is the rest of the line, so it may contain spaces
+			getline(fields >> ws, settings.simName);
+			settings.simName.erase(settings.simName.find_last_not_of(" \t\r") + 1);
+			ok = !settings.simName.empty();
+		}
+		else
+		{
+			printf("%s:%i: unknown parameter \"%s\"\n", fileName.c_str(), lineNum, name.c_str());
+			return false;
+		}
+
+		if (!ok || (fields >> rest))
+		{
+			printf("%s:%i: bad value for %s\n", fileName.c_str(), lineNum, name.c_str());
+			return false;
+		}
+	}
+	return true;
+}
+
+bool saveSettingsText(const string& fileName, const simSettings& settings)
+{
+	FILE* out = fopen(fileName.c_str(), "w");
+	if (out == NULL)
+	{
+		printf("Could not open %s for writing\n", fileName.c_str());
+		return false;
+	}
+	const simParams& p = settings.params;
+	fprintf(out, "bsLen %i\nantNum %i\ntransNum %i\ntransDist %.17g\ndRateMax %i\nuePerAnt %i\n", p.bsLen, p.antNum, p.transNum, p.transDist, p.dRateMax, p.uePerAnt);
+	fprintf(out, "simLen %i\nsimNum %i\nsimStartNum %i\nsimName %s\nbufSize %i\n", p.simLen, settings.simNum, settings.simStartNum, settings.simName.c_str(), p.bufSize);
+	fprintf(out, "selfHealing %i\nseriesInterval %.17g\nseriesCsv %i\ncheckpointInterval %.17g\nregions %i\n", p.selfHealing, settings.series.interval, (int)settings.series.csv, settings.series.checkpoint, settings.series.regions);
+	for (int i = 0; i < (int)settings.sweep.size(); i++)
+	{
+		fprintf(out, "sweep %s %s\n", settings.sweep[i].first.c_str(), settings.sweep[i].second.c_str());
+	}
+	fclose(out);
+	return true;
+}
+
+bool isLayoutBinary(const string& fileName)
+{
+	char magic[4];
+	FILE* in = fopen(fileName.c_str(), "rb");
+	if (in == NULL)
+		return false;
+	bool binary = (fread(magic, 1, 4, in) == 4 && memcmp(magic, LAYOUT_MAGIC, 4) == 0);
+	fclose(in);
+	return binary;
+}
+
+// true if an int32 array of "tiles" entries at "offset" lies inside the file
+static bool arrayFits(uint64_t offset, uint32_t tiles, size_t size)
+{
+	return offset % sizeof(int32_t) == 0 && offset <= size && (size - offset) / sizeof(int32_t) >= tiles;
+}
+
+bool mapLayout(const string& fileName, mappedLayout& layout)
+{
+	unmapLayout(layout);
+	int fd = open(fileName.c_str(), O_RDONLY);
+	if (fd < 0)
+	{
+		printf("Could not open %s for reading\n", fileName.c_str());
+		return false;
+	}
+	struct stat info;
+	void* base = MAP_FAILED;
+	if (fstat(fd, &info) == 0 && (size_t)info.st_size >= sizeof(layoutFileHeader))
+	{
+		base = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	}
+	close(fd);	// the mapping stays valid without the descriptor
+	if (base == MAP_FAILED)
+	{
+		printf("%s is not a layout file\n", fileName.c_str());
+		return false;
+	}
+
+	size_t size = info.st_size;
+	const layoutFileHeader& head = *(const layoutFileHeader*)base;
+	const char* problem = NULL;
+	if (memcmp(head.magic, LAYOUT_MAGIC, 4) != 0)
+		problem = "is not a layout file";
+	else if (head.version != LAYOUT_VERSION)
+		problem = "was written by a different version";
+	else if (head.byteOrder != LAYOUT_BYTE_ORDER)
+		problem = "was written on a machine with a different byte order";
+	else if (!arrayFits(head.qOffset, head.tiles, size) || !arrayFits(head.rOffset, head.tiles, size) || !arrayFits(head.stateOffset, head.tiles, size) || !arrayFits(head.pathOffset, head.tiles, size) || head.tiles > 0x7fffffff)
+		problem = "is truncated";
+
+	// the same checks the text loader makes: states 0-3 and one tile per cell
+	if (problem == NULL)
+	{
+		const int32_t* q = (const int32_t*)((const char*)base + head.qOffset);
+		const int32_t* r = (const int32_t*)((const char*)base + head.rOffset);
+		const int32_t* state = (const int32_t*)((const char*)base + head.stateOffset);
+		unordered_map<long long, int> index;
+		index.reserve(head.tiles);
+		for (uint32_t i = 0; i < head.tiles && problem == NULL; i++)
+		{
+			if (state[i] < 0 || state[i] > 3)
+				problem = "holds a tile state outside 0-3";
+			else if (!index.insert(make_pair(hexKey(q[i], r[i]), (int)i)).second)
+				problem = "holds more than one tile in a cell";
+		}
+	}
+	if (problem != NULL)
+	{
+		printf("%s %s\n", fileName.c_str(), problem);
+		munmap(base, size);
+		return false;
+	}
+
+	layout.base = base;
+	layout.size = size;
+	layout.view.tiles = (int)head.tiles;
+	layout.view.q = (const int32_t*)((const char*)base + head.qOffset);
+	layout.view.r = (const int32_t*)((const char*)base + head.rOffset);
+	layout.view.state = (const int32_t*)((const char*)base + head.stateOffset);
+	layout.view.path = (const int32_t*)((const char*)base + head.pathOffset);
+
+	const layoutFileParams& p = head.params;
+	simSettings& settings = layout.settings;
+	settings.params.bsLen = p.bsLen;
+	settings.params.antNum = p.antNum;
+	settings.params.transNum = p.transNum;
+	settings.params.transDist = p.transDist;
+	settings.params.dRateMax = p.dRateMax;
+	settings.params.uePerAnt = p.uePerAnt;
+	settings.params.simLen = p.simLen;
+	settings.params.bufSize = p.bufSize;
+	settings.params.selfHealing = p.selfHealing;
+	settings.simNum = p.simNum;
+	settings.simStartNum = p.simStartNum;
+	settings.simName.assign(p.simName, strnlen(p.simName, sizeof(p.simName)));
+	return true;
+}
+
+void unmapLayout(mappedLayout& layout)
+{
+	if (layout.base != NULL)
+		munmap(layout.base, layout.size);
+	layout = mappedLayout();
+}
+
+bool saveLayoutBinary(const string& fileName, const simLayout& layout, const simSettings& settings)
+{
+	uint32_t tiles = (uint32_t)layout.axial.size();
+	uint64_t arrayBytes = ((uint64_t)tiles * sizeof(int32_t) + 7) / 8 * 8;
+
+	layoutFileHeader head;
+	memset(&head, 0, sizeof(head));
+	memcpy(head.magic, LAYOUT_MAGIC, 4);
+	head.version = LAYOUT_VERSION;
+	head.byteOrder = LAYOUT_BYTE_ORDER;
+	head.tiles = tiles;
+	head.qOffset = sizeof(head);
+	head.rOffset = head.qOffset + arrayBytes;
+	head.stateOffset = head.rOffset + arrayBytes;
+	head.pathOffset = head.stateOffset + arrayBytes;
+
+	layoutFileParams& p = head.params;
+	p.bsLen = settings.params.bsLen;
+	p.antNum = settings.params.antNum;
+	p.transNum = settings.params.transNum;
+	p.transDist = settings.params.transDist;
+	p.dRateMax = settings.params.dRateMax;
+	p.uePerAnt = settings.params.uePerAnt;
+	p.simLen = settings.params.simLen;
+	p.bufSize = settings.params.bufSize;
+	p.selfHealing = settings.params.selfHealing;
+	p.simNum = settings.simNum;
+	p.simStartNum = settings.simStartNum;
+	strncpy(p.simName, settings.simName.c_str(), sizeof(p.simName) - 1);
+
+	// the four arrays go out back to back, each padded to a multiple of 8 bytes
+	vector<int32_t> arrays(4 * arrayBytes / sizeof(int32_t), 0);
+	int32_t* q = &arrays[0];
+	int32_t* r = q + arrayBytes / sizeof(int32_t);
+	int32_t* state = r + arrayBytes / sizeof(int32_t);
+	int32_t* path = state + arrayBytes / sizeof(int32_t);
+	for (uint32_t i = 0; i < tiles; i++)
+	{
+		q[i] = layout.axial[i].first;
+		r[i] = layout.axial[i].second;
+		state[i] = layout.state[i];
+		path[i] = layout.path[i];
+	}
+
+	FILE* out = fopen(fileName.c_str(), "wb");
+	if (out == NULL)
+	{
+		printf("Could not open %s for writing\n", fileName.c_str());
+		return false;
+	}
+	bool ok = (fwrite(&head, sizeof(head), 1, out) == 1);
+	if (ok && !arrays.empty())
+		ok = (fwrite(&arrays[0], sizeof(int32_t), arrays.size(), out) == arrays.size());
+	ok = (fclose(out) == 0) && ok;
+	if (!ok)
+		printf("Could not write %s\n", fileName.c_str());
+	return ok;
+}
+
+simTopology viewTopology(const layoutView& view)
+{
+	unordered_map<long long, int> index;
+	index.reserve(view.tiles);
+	for (int i = 0; i < view.tiles; i++)
+	{
+		index[hexKey(view.q[i], view.r[i])] = i;
+	}
+	simTopology topo;
+	topo.state.assign(view.state, view.state + view.tiles);
+	neighborsOf(view.tiles, [&](int n) { return (int)view.q[n]; }, [&](int n) { return (int)view.r[n]; }, index, topo.neighbors);
+	return topo;
+}
@@ -0,0 +1,129 @@
+#ifndef SHNSIM_LAYOUT_H
+#define SHNSIM_LAYOUT_H
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <utility>
+#include <unordered_map>
+#include "SHNSim_Engine.h"
+#include "SHNSim_Results.h"
+
+// axial offsets (q,r) of the six neighbors of a tile, indexed by the side
+// number stored in the neighbor lists
+extern const int hexDir[6][2];
+
+// side number of the neighbor at axial offset (dq, dr); -1 if not adjacent
+int hexSide(int dq, int dr);
+
+// packed (q,r) key of the lattice cell index
+long long hexKey(int q, int r);
+
+// network as drawn: lattice position, state and path code of every tile
+struct simLayout
+{
+	std::vector<std::pair<int, int>> axial;
+	std::vector<int> state;	// 0 = healthy, 1 = congested, 2 = alt congested, 3 = down
+	std::vector<int> path;
+};
+
+// everything a batch needs besides the layout (the fields of the parameter window)
+struct simSettings
+{
+	simParams params;
+	std::string simName = "default name";
+	int simNum = 1;
+	int simStartNum = 0;
+	resultsOptions series;	// seriesInterval, seriesCsv and checkpointInterval in a settings file
+	std::vector<std::pair<std::string, std::string>> sweep;	// (parameter, list or range) of a sweep, see SHNSim_Sweep.h
+};
+
+// build the (q,r) -> tile index of a list of lattice positions
+void indexLayout(const std::vector<std::pair<int, int>>& axial, std::unordered_map<long long, int>& index);
+
+// tile in cell (q,r), or -1 if the cell is empty
+int findCell(const std::unordered_map<long long, int>& index, int q, int r);
+
+// (tile, side) neighbor lists of every tile
+void buildNeighbors(const std::vector<std::pair<int, int>>& axial, const std::unordered_map<long long, int>& index, std::vector<std::vector<std::pair<int, int>>>& neighbors);
+
+// network the simulation engine runs for a layout
+simTopology layoutTopology(const simLayout& layout);
+
+// text layout file: one "q r state path" line per tile; '#' starts a comment.
+// Loading fails (with a message on stdout) on malformed lines or repeated cells
+bool loadLayoutText(const std::string& fileName, simLayout& layout);
+bool saveLayoutText(const std::string& fileName, const simLayout& layout);
+
+// text settings file: one "name value" line per parameter, using the names of
+// the parameter window fields (bsLen, antNum, ..., simName); missing names keep
+// their defaults, unknown names or bad values make loading fail. A
+// "sweep <name> <list or range>" line sweeps a parameter (checked when the
+// sweep is run)
+bool loadSettingsText(const std::string& fileName, simSettings& settings);
+bool saveSettingsText(const std::string& fileName, const simSettings& settings);
+
+// Binary layout file, version LAYOUT_VERSION, in native byte order:
+//   layoutFileHeader (its size is a multiple of 8)
+//   int32 q[tiles], r[tiles], state[tiles], path[tiles], each array starting at
+//   the 8 byte aligned offset recorded in the header
+// Readers go through the offsets, so later versions can append header fields
+// or arrays without moving the existing ones
+static const char LAYOUT_MAGIC[4] = {'S', 'H', 'N', 'L'};
+static const uint32_t LAYOUT_VERSION = 1;
+static const uint32_t LAYOUT_BYTE_ORDER = 0x01020304;
+
+struct layoutFileParams
+{
+	int32_t bsLen, antNum, transNum, dRateMax, uePerAnt, simLen, bufSize;
+	int32_t simNum, simStartNum, selfHealing;	// selfHealing was a zeroed pad before it was used
+	double transDist;
+	char simName[128];	// NUL terminated
+};
+
+struct layoutFileHeader
+{
+	char magic[4];
+	uint32_t version;
+	uint32_t byteOrder;	// LAYOUT_BYTE_ORDER as written by the saving machine
+	uint32_t tiles;
+	uint64_t qOffset, rOffset, stateOffset, pathOffset;	// from the start of the file
+	layoutFileParams params;
+};
+static_assert(sizeof(layoutFileHeader) % 8 == 0, "arrays must start 8 byte aligned");
+
+// read-only arrays of a layout, pointing straight into a mapped file
+struct layoutView
+{
+	int tiles = 0;
+	const int32_t* q = NULL;
+	const int32_t* r = NULL;
+	const int32_t* state = NULL;
+	const int32_t* path = NULL;
+};
+
+// binary layout file mapped into memory; nothing is copied until the caller
+// reads the view, opening only reads the arrays once to check them
+struct mappedLayout
+{
+	layoutView view;
+	simSettings settings;
+	void* base = NULL;
+	size_t size = 0;
+};
+
+// true if the file starts with the binary layout magic
+bool isLayoutBinary(const std::string& fileName);
+
+// map a binary layout file; fails (with a message on stdout) on a wrong magic,
+// version or byte order, on arrays that do not fit in the file and, as
+// loadLayoutText() does, on states outside 0-3 and cells with two tiles
+bool mapLayout(const std::string& fileName, mappedLayout& layout);
+void unmapLayout(mappedLayout& layout);
+
+bool saveLayoutBinary(const std::string& fileName, const simLayout& layout, const simSettings& settings);
+
+// network the simulation engine runs for a mapped layout
+simTopology viewTopology(const layoutView& view);
+
+#endif
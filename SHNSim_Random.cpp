@@ -0,0 +1,169 @@
+#include "SHNSim_Random.h"
+#include <math.h>
+
+// Philox4x32 multipliers and key increments (Salmon et al., "Parallel random
+// numbers: as easy as 1, 2, 3", 2011)
+static const uint32_t PHILOX_M0 = 0xD2511F53;
+static const uint32_t PHILOX_M1 = 0xCD9E8D57;
+static const uint32_t PHILOX_W0 = 0x9E3779B9;
+static const uint32_t PHILOX_W1 = 0xBB67AE85;
+static const int PHILOX_ROUNDS = 10;
+static const int RNG_BLOCKS = RNG_BATCH / 2;
+
+// right edge of the base layer of the exponential ziggurat and the area of a layer
+static const double ZIGGURAT_R = 7.697117470131487;
+static const double ZIGGURAT_V = 3.949659822581572e-3;
+
+uint64_t zigguratK[256];
+double zigguratW[256];
+double zigguratF[256];
+
+static bool makeZiggurat()
+{
+	// layer boundaries as in Marsaglia and Tsang's zigset(), scaled to the 53
+	// bit integers rngExponential() draws
+	const double scale = 9007199254740992.0;
+	double de = ZIGGURAT_R, te = de;
+	double q = ZIGGURAT_V / exp(-de);
+	zigguratK[0] = (uint64_t)(de / q * scale);
+	zigguratK[1] = 0;
+	zigguratW[0] = q / scale;
+	zigguratW[255] = de / scale;
+	zigguratF[0] = 1;
+	zigguratF[255] = exp(-de);
+	for (int i = 254; i >= 1; i--)
+	{
+		de = -log(ZIGGURAT_V / de + exp(-de));
+		zigguratK[i + 1] = (uint64_t)(de / te * scale);
+		te = de;
+		zigguratF[i] = exp(-de);
+		zigguratW[i] = de / scale;
+	}
+	return true;
+}
+static const bool zigguratReady = makeZiggurat();
+
+static uint64_t mix(uint64_t z)
+{
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+	return z ^ (z >> 31);
+}
+
+void rngInit(rngStream& s, uint64_t seed, int tile, rngName name)
+{
+	uint64_t h = mix(seed + 0x9E3779B97F4A7C15ULL * ((uint64_t)(uint32_t)tile + 1));
+	h = mix(h ^ (0xD1B54A32D192ED03ULL * ((uint64_t)name + 1)));
+	s.key[0] = (uint32_t)h;
+	s.key[1] = (uint32_t)(h >> 32);
+	s.block = 0;
+	s.next = RNG_BATCH;
+}
+
+void rngRefill(rngStream& s)
+{
+	// the blocks are independent, so every round is one loop over them
+	uint32_t c0[RNG_BLOCKS], c1[RNG_BLOCKS], c2[RNG_BLOCKS], c3[RNG_BLOCKS];
+	for (int b = 0; b < RNG_BLOCKS; b++)
+	{
+		uint64_t counter = s.block + b;
+		c0[b] = (uint32_t)counter;
+		c1[b] = (uint32_t)(counter >> 32);
+		c2[b] = 0;
+		c3[b] = 0;
+	}
+	uint32_t k0 = s.key[0], k1 = s.key[1];
+	for (int r = 0; r < PHILOX_ROUNDS; r++)
+	{
+		for (int b = 0; b < RNG_BLOCKS; b++)
+		{
+			uint64_t p0 = (uint64_t)PHILOX_M0 * c0[b];
+			uint64_t p1 = (uint64_t)PHILOX_M1 * c2[b];
+			uint32_t x1 = c1[b], x3 = c3[b];
+			c0[b] = (uint32_t)(p1 >> 32) ^ x1 ^ k0;
+			c1[b] = (uint32_t)p1;
+			c2[b] = (uint32_t)(p0 >> 32) ^ x3 ^ k1;
+			c3[b] = (uint32_t)p0;
+		}
+		k0 += PHILOX_W0;
+		k1 += PHILOX_W1;
+	}
+	for (int b = 0; b < RNG_BLOCKS; b++)
+	{
+		s.words[2 * b] = c0[b] | ((uint64_t)c1[b] << 32);
+		s.words[2 * b + 1] = c2[b] | ((uint64_t)c3[b] << 32);
+	}
+	s.block += RNG_BLOCKS;
+	s.next = 0;
+}
+
+double rngExponentialSlow(rngStream& s, uint64_t bits, int layer)
+{
+	while (true)
+	{
+		// the base layer's tail beyond R is R plus another unit exponential
+		if (layer == 0)
+			return ZIGGURAT_R - log1p(-rngUniform(s));
+		double x = bits * zigguratW[layer];
+		if (zigguratF[layer] + rngUniform(s) * (zigguratF[layer - 1] - zigguratF[layer]) < exp(-x))
+			return x;
+
+		bits = rngNext(s) >> 3;
+		layer = (int)(bits & 0xFF);
+		bits >>= 8;
+		if (bits < zigguratK[layer])
+			return bits * zigguratW[layer];
+	}
+}
+
+void rngFillUniform(rngStream& s, double* out, size_t n)
+{
+	size_t i = 0;
+	while (i < n)
+	{
+		if (s.next == RNG_BATCH)
+			rngRefill(s);
+		size_t take = (size_t)(RNG_BATCH - s.next);
+		if (take > n - i)
+			take = n - i;
+		for (size_t j = 0; j < take; j++)
+		{
+			out[i + j] = (s.words[s.next + j] >> 11) * (1.0 / 9007199254740992.0);
+		}
+		s.next += (int)take;
+		i += take;
+	}
+}
+
+void rngFillExponential(rngStream& s, double* out, size_t n)
+{
+	size_t i = 0;
+	while (i < n)
+	{
+		if (s.next == RNG_BATCH)
+			rngRefill(s);
+		size_t take = (size_t)(RNG_BATCH - s.next);
+		if (take > n - i)
+			take = n - i;
+		// fast path for every word of the slice, then keep the draws before
+		// the first one that missed its rectangle
+		const uint64_t* words = s.words + s.next;
+		for (size_t j = 0; j < take; j++)
+		{
+			uint64_t bits = words[j] >> 3;
+			out[i + j] = (bits >> 8) * zigguratW[bits & 0xFF];
+		}
+		size_t kept = 0;
+		while (kept < take && (words[kept] >> 11) < zigguratK[(words[kept] >> 3) & 0xFF])
+		{
+			kept++;
+		}
+		s.next += (int)kept;
+		i += kept;
+		if (kept < take)
+		{
+			uint64_t bits = rngNext(s) >> 3;
+			out[i++] = rngExponentialSlow(s, bits >> 8, (int)(bits & 0xFF));
+		}
+	}
+}
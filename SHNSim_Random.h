@@ -0,0 +1,78 @@
+#ifndef SHNSIM_RANDOM_H
+#define SHNSIM_RANDOM_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Counter based random streams (Philox4x32-10). Word n of a stream is a pure
+// function of the stream's key and n, and the key is derived from the run's
+// seed, a tile and a stream name, so every tile of a run draws its own numbers
+// no matter which thread handles the tile or what other tiles do. Words are
+// generated RNG_BATCH at a time by a loop over independent counters, which the
+// compiler turns into vector code
+static const int RNG_BATCH = 16;	// words per refill, two per Philox block
+
+// named streams of a tile
+enum rngName
+{
+	RNG_SETUP,	// data rates and first packet times of the tile's UEs
+	RNG_TRAFFIC	// packet gaps and service times of packets handled by the tile's antennas
+};
+
+struct rngStream
+{
+	uint64_t words[RNG_BATCH];
+	uint32_t key[2];
+	uint64_t block;	// Philox counter of the first block of the next refill
+	int next;	// next unused word; RNG_BATCH = refill first
+};
+
+// stream "name" of "tile" in the run seeded with "seed"
+void rngInit(rngStream& s, uint64_t seed, int tile, rngName name);
+
+// generate the next RNG_BATCH words
+void rngRefill(rngStream& s);
+
+inline uint64_t rngNext(rngStream& s)
+{
+	if (s.next == RNG_BATCH)
+		rngRefill(s);
+	return s.words[s.next++];
+}
+
+// uniform on [0, 1)
+inline double rngUniform(rngStream& s)
+{
+	return (rngNext(s) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+// 256 layer ziggurat of the unit exponential (Marsaglia and Tsang)
+extern uint64_t zigguratK[256];
+extern double zigguratW[256];
+extern double zigguratF[256];
+
+// draws that fall outside the rectangles of the ziggurat, about 1 in 90
+double rngExponentialSlow(rngStream& s, uint64_t bits, int layer);
+
+// exponential with mean 1; most draws take one word, a table lookup and a
+// multiply instead of a logarithm
+inline double rngExponential(rngStream& s)
+{
+	uint64_t bits = rngNext(s) >> 3;
+	int layer = (int)(bits & 0xFF);
+	bits >>= 8;
+	if (bits < zigguratK[layer])
+		return bits * zigguratW[layer];
+	return rngExponentialSlow(s, bits, layer);
+}
+
+// the next n uniform draws of the stream, as n calls of rngUniform() would
+// return them
+void rngFillUniform(rngStream& s, double* out, size_t n);
+
+// the next n exponential draws of the stream, as n calls of rngExponential()
+// would return them; the ziggurat's fast path runs over a whole batch of words
+// at a time
+void rngFillExponential(rngStream& s, double* out, size_t n);
+
+#endif
@@ -0,0 +1,269 @@
+#include "SHNSim_Regions.h"
+#include "SHNSim_Checkpoint.h"
+#include <stdio.h>
+#include <algorithm>
+
+using namespace std;
+
+void partitionTiles(const simTopology& topo, const simParams& params, int regions, vector<int>& region)
+{
+	int tiles = (int)topo.state.size();
+	int antNum = max(1, params.antNum);
+	int uePerAnt = max(0, params.uePerAnt);
+	regions = max(1, min(regions, tiles));
+
+	// UEs served by every tile, after the handovers of self-healing
+	vector<double> load(tiles, 0);
+	bool healing = (params.selfHealing && (int)topo.handover.size() == tiles);
+	for (int t = 0; t < tiles; t++)
+	{
+		double ues = (double)antNum * uePerAnt * (topo.state[t] == 1 || topo.state[t] == 2 ? 2 : 1);
+		load[t] += ues;
+		for (int i = 0; healing && i < (int)topo.handover[t].size(); i++)
+		{
+			load[topo.handover[t][i].first] += topo.handover[t][i].second * ues;
+			load[t] -= topo.handover[t][i].second * ues;
+		}
+	}
+
+	// breadth first from tile 0, and from the first tile left over for every
+	// part of the network not connected to it
+	vector<int> order;
+	vector<char> seen(tiles, 0);
+	order.reserve(tiles);
+	for (int start = 0; start < tiles; start++)
+	{
+		if (seen[start])
+			continue;
+		seen[start] = 1;
+		order.push_back(start);
+		for (int head = (int)order.size() - 1; head < (int)order.size(); head++)
+		{
+			const vector<pair<int, int>>& next = topo.neighbors[order[head]];
+			for (int i = 0; i < (int)next.size(); i++)
+			{
+				if (!seen[next[i].first])
+				{
+					seen[next[i].first] = 1;
+					order.push_back(next[i].first);
+				}
+			}
+		}
+	}
+
+	double total = 0;
+	for (int t = 0; t < tiles; t++)
+	{
+		total += load[t];
+	}
+	region.assign(tiles, 0);
+	double before = 0;
+	for (int i = 0; i < tiles; i++)
+	{
+		int t = order[i];
+		double middle = (total > 0 ? (before + load[t] / 2) / total : (i + 0.5) / tiles);
+		region[t] = min(regions - 1, (int)(middle * regions));
+		before += load[t];
+	}
+}
+
+static void regionWorker(regionWorkers* workers, int r, long long round)
+{
+	unique_lock<mutex> hold(workers->lock);
+	while (true)
+	{
+		workers->wake.wait(hold, [&] { return workers->quit || workers->round != round; });
+		if (workers->quit)
+			return;
+		round = workers->round;
+		hold.unlock();
+		(*workers->work)(r);
+		hold.lock();
+		if (--workers->busy == 0)
+			workers->done.notify_one();
+	}
+}
+
+static void stopWorkers(regionWorkers& workers)
+{
+	{
+		lock_guard<mutex> hold(workers.lock);
+		workers.quit = true;
+	}
+	workers.wake.notify_all();
+	for (int i = 0; i < (int)workers.threads.size(); i++)
+	{
+		workers.threads[i].join();
+	}
+	workers.threads.clear();
+	workers.quit = false;
+}
+
+regionWorkers::~regionWorkers()
+{
+	stopWorkers(*this);
+}
+
+// one waiting thread for every region but the first
+static void startWorkers(regionWorkers& workers, int regions)
+{
+	if ((int)workers.threads.size() == regions - 1)
+		return;
+	stopWorkers(workers);
+	for (int r = 1; r < regions; r++)
+	{
+		workers.threads.push_back(thread(regionWorker, &workers, r, workers.round));
+	}
+}
+
+// run "work" for every region, regions 1.. on the worker threads and region 0
+// on the caller's, and wait until all are done
+static void forRegions(simRegions& group, const function<void(int)>& work)
+{
+	regionWorkers& workers = group.workers;
+	if (!workers.threads.empty())
+	{
+		lock_guard<mutex> hold(workers.lock);
+		workers.work = &work;
+		workers.busy = (int)workers.threads.size();
+		workers.round++;
+	}
+	workers.wake.notify_all();
+	work(0);
+	unique_lock<mutex> hold(workers.lock);
+	workers.done.wait(hold, [&] { return workers.busy == 0; });
+}
+
+// copy what region r runs into the view; regions write disjoint parts, so
+// all of them can do this at once
+static void mergeRegion(simRegions& group, int r)
+{
+	const simEngine& eng = *group.engines[r];
+	simEngine& view = group.view;
+	int antNum = max(1, eng.params.antNum);
+	for (int i = 0; i < (int)eng.tileId.size(); i++)
+	{
+		view.stats[eng.tileId[i]] = eng.stats[i];
+	}
+	for (int a = 0; a < (int)eng.antBuffer.size(); a++)
+	{
+		view.antBuffer[eng.tileId[eng.antTile[a]] * antNum + a % antNum] = eng.antBuffer[a];
+	}
+}
+
+// the view's clock and counters, once every region has merged its part
+static void mergeTotals(simRegions& group)
+{
+	simEngine& view = group.view;
+	view.now = group.engines[0]->now;
+	view.events = 0;
+	view.wallSeconds = 0;
+	view.allocations = 0;
+	for (int r = 0; r < (int)group.engines.size(); r++)
+	{
+		const simEngine& eng = *group.engines[r];
+		view.now = min(view.now, eng.now);
+		view.events += eng.events;
+		view.wallSeconds = max(view.wallSeconds, eng.wallSeconds);
+		view.allocations += eng.allocations;
+	}
+}
+
+void initRegions(simRegions& group, const simTopology& topo, const simParams& params, unsigned long long seed, int regions)
+{
+	int tiles = (int)topo.state.size();
+	partitionTiles(topo, params, regions, group.region);
+	int count = max(1, min(regions, tiles));
+	group.owned.assign(count, vector<char>(tiles, 0));
+	for (int t = 0; t < tiles; t++)
+	{
+		group.owned[group.region[t]][t] = 1;
+	}
+	startWorkers(group.workers, count);
+	group.engines.resize(count);
+	for (int r = 0; r < count; r++)
+	{
+		if (!group.engines[r])
+			group.engines[r].reset(new simEngine);
+	}
+
+	// the view only holds what results and progress read, numbered as the
+	// topology numbers tiles and antennas
+	simEngine& view = group.view;
+	int antNum = max(1, params.antNum);
+	size_t antennas = (size_t)tiles * antNum;
+	arenaReset(view.arena, arenaBytes<int>(tiles) + arenaBytes<tileStats>(tiles) + arenaBytes<int>(antennas) + arenaBytes<packetBuffer>(antennas));
+	arenaCarve(view.arena, view.tileState, tiles);
+	arenaCarve(view.arena, view.stats, tiles);
+	arenaCarve(view.arena, view.antTile, antennas);
+	arenaCarve(view.arena, view.antBuffer, antennas);
+	view.params = params;
+	view.params.bufSize = max(0, params.bufSize);
+	for (int t = 0; t < tiles; t++)
+	{
+		view.tileState.push_back(topo.state[t]);
+		for (int a = 0; a < antNum; a++)
+		{
+			view.antTile.push_back(t);
+		}
+	}
+	view.stats.resize(tiles);
+	view.antBuffer.resize(antennas);
+
+	forRegions(group, [&](int r)
+	{
+		initSimulation(*group.engines[r], topo, params, seed, &group.owned[r]);
+		mergeRegion(group, r);
+	});
+	mergeTotals(group);
+}
+
+bool stepRegions(simRegions& group, double until)
+{
+	vector<char> more(group.engines.size(), 0);
+	forRegions(group, [&](int r)
+	{
+		more[r] = stepSimulation(*group.engines[r], until);
+		mergeRegion(group, r);
+	});
+	mergeTotals(group);
+	return find(more.begin(), more.end(), 1) != more.end();
+}
+
+string regionFileName(const string& fileName, int r, int regions)
+{
+	return fileName + "." + to_string(r) + "of" + to_string(regions);
+}
+
+bool saveRegions(const simRegions& group, const string& fileName, uint64_t seriesRows)
+{
+	int regions = (int)group.engines.size();
+	bool ok = true;
+	for (int r = 0; r < regions; r++)
+	{
+		ok = saveCheckpoint(*group.engines[r], regionFileName(fileName, r, regions), seriesRows) && ok;
+	}
+	return ok;
+}
+
+bool loadRegions(simRegions& group, const string& fileName, uint64_t* seriesRows)
+{
+	int regions = (int)group.engines.size();
+	for (int r = 0; r < regions; r++)
+	{
+		if (!loadCheckpoint(*group.engines[r], regionFileName(fileName, r, regions), (r == 0 ? seriesRows : NULL)))
+			return false;
+	}
+	forRegions(group, [&](int r) { mergeRegion(group, r); });
+	mergeTotals(group);
+	return true;
+}
+
+void removeRegions(const simRegions& group, const string& fileName)
+{
+	int regions = (int)group.engines.size();
+	for (int r = 0; r < regions; r++)
+	{
+		remove(regionFileName(fileName, r, regions).c_str());
+	}
+}
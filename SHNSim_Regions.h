@@ -0,0 +1,80 @@
+#ifndef SHNSIM_REGIONS_H
+#define SHNSIM_REGIONS_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <stdint.h>
+#include "SHNSim_Engine.h"
+
+// Spatial split of a single run: the tiles are cut into contiguous regions of
+// about equal load and every region runs its own event queue on its own thread
+// (a simEngine that only holds the tiles it owns and the UEs they serve, see
+// initSimulation()). Regions advance in windows that end on the times the
+// caller steps to, and meet at the end of every window.
+//
+// No event of this model crosses a region: a UE's packets are handled by the
+// tile serving it, handovers (self-healing) are fixed when the run starts,
+// every tile draws from its own random streams and alt congested tiles switch
+// on a common clock. The windows therefore exchange nothing and may be of any
+// length, and a run split into any number of regions gives the same per tile
+// results, bit for bit, as a single event queue
+// threads that run regions 1.. for the whole life of a simRegions; between
+// windows they wait on "wake" until the next piece of work is handed out
+struct regionWorkers
+{
+	std::vector<std::thread> threads;	// thread i runs region i + 1
+	std::mutex lock;
+	std::condition_variable wake, done;
+	const std::function<void(int)>* work = NULL;	// work of the current window, given the region
+	long long round = 0;	// counts the pieces of work handed out
+	int busy = 0;	// threads still running the current one
+	bool quit = false;
+
+	regionWorkers() {}
+	regionWorkers(const regionWorkers&) = delete;
+	regionWorkers& operator=(const regionWorkers&) = delete;
+	~regionWorkers();
+};
+
+struct simRegions
+{
+	std::vector<int> region;	// region of every tile
+	std::vector<std::vector<char>> owned;	// tiles of every region
+	std::vector<std::unique_ptr<simEngine>> engines;	// one per region
+
+	// all regions merged after every window, for results and progress: now,
+	// events, allocations, tileState, stats, antTile and antBuffer, and the
+	// wallSeconds of the slowest region
+	simEngine view;
+
+	// last, so the threads are stopped before the engines they run go away
+	regionWorkers workers;
+};
+
+// cut the tiles into "regions" regions: tiles are taken in breadth first
+// order, so a region is a band around the previous one, and cut where the
+// UEs served so far pass a multiple of the total / regions
+void partitionTiles(const simTopology& topo, const simParams& params, int regions, std::vector<int>& region);
+
+// set up a run split into "regions" regions (at most one per tile)
+void initRegions(simRegions& group, const simTopology& topo, const simParams& params, unsigned long long seed, int regions);
+
+// advance every region to "until", regions 1.. on the group's worker threads
+// and region 0 on the caller's, then merge the view; returns false once the run is over
+bool stepRegions(simRegions& group, double until);
+
+// snapshot of region r of a run split into "regions": "<fileName>.<r>of<regions>"
+std::string regionFileName(const std::string& fileName, int r, int regions);
+
+// snapshots of all regions, saved and restored with SHNSim_Checkpoint.h; after
+// a failed restore the run has to be set up again with initRegions()
+bool saveRegions(const simRegions& group, const std::string& fileName, uint64_t seriesRows = 0);
+bool loadRegions(simRegions& group, const std::string& fileName, uint64_t* seriesRows = NULL);
+void removeRegions(const simRegions& group, const std::string& fileName);
+
+#endif
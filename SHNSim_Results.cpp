@@ -0,0 +1,299 @@
+#include "SHNSim_Results.h"
+#include "SHNSim_Trace.h"
+#include <string.h>
+#include <unistd.h>
+
+using namespace std;
+
+static const size_t FILE_BUFFER = 1 << 20;
+
+string runFileName(const string& simName, int run)
+{
+	return simName + "_" + to_string(run) + ".csv";
+}
+
+string seriesFileName(const string& simName, int run, bool csv)
+{
+	return simName + "_" + to_string(run) + (csv ? "_series.csv" : "_series.bin");
+}
+
+// a resumed run appends to what trimSeries() left of its file, any other
+// starts it afresh
+static FILE* openSeries(resultsWriter& writer, int run, bool append = false)
+{
+	map<int, FILE*>::iterator it = writer.series.find(run);
+	if (it != writer.series.end())
+		return it->second;
+
+	string fileName = seriesFileName(writer.simName, run, writer.options.csv);
+	FILE* out = fopen(fileName.c_str(), writer.options.csv ? (append ? "a" : "w") : (append ? "ab" : "wb"));
+	if (out == NULL)
+	{
+		printf("Could not open %s for writing\n", fileName.c_str());
+	}
+	else
+	{
+		setvbuf(out, NULL, _IOFBF, FILE_BUFFER);
+		if (append)
+		{
+			// the header is already there
+		}
+		else if (writer.options.csv)
+		{
+			writer.bytes += fprintf(out, "time,tile,arrivals,served,dropped,blocked,queued\n");
+		}
+		else
+		{
+			fwrite("SHNR", 1, 4, out);
+			fwrite(&RESULTS_VERSION, sizeof(RESULTS_VERSION), 1, out);
+			fwrite(&writer.options.interval, sizeof(double), 1, out);
+			writer.bytes += RESULTS_HEADER_BYTES;
+		}
+	}
+	writer.series[run] = out;	// NULL is kept too, so a failed open is only reported once
+	return out;
+}
+
+template <class T>
+static void writeColumn(resultsWriter& writer, const vector<T>& column, FILE* out)
+{
+	if (!column.empty())
+		writer.bytes += sizeof(T) * fwrite(&column[0], sizeof(T), column.size(), out);
+}
+
+static void writeSeries(resultsWriter& writer, const resultsBlock& block)
+{
+	FILE* out = openSeries(writer, block.run);
+	if (out == NULL)
+		return;
+
+	uint32_t rows = block.rows();
+	if (writer.options.csv)
+	{
+		for (uint32_t i = 0; i < rows; i++)
+		{
+			writer.bytes += fprintf(out, "%.17g,%i,%lld,%lld,%lld,%lld,%i\n", block.time[i], block.tile[i], block.arrivals[i], block.served[i], block.dropped[i], block.blocked[i], block.queued[i]);
+		}
+		return;
+	}
+	fwrite(&rows, sizeof(rows), 1, out);
+	writer.bytes += sizeof(rows);
+	writeColumn(writer, block.time, out);
+	writeColumn(writer, block.tile, out);
+	writeColumn(writer, block.arrivals, out);
+	writeColumn(writer, block.served, out);
+	writeColumn(writer, block.dropped, out);
+	writeColumn(writer, block.blocked, out);
+	writeColumn(writer, block.queued, out);
+}
+
+static void writeSummary(resultsWriter& writer, const resultsBlock& block)
+{
+	string fileName = runFileName(writer.simName, block.run);
+	FILE* out = fopen(fileName.c_str(), "w");
+	if (out == NULL)
+	{
+		printf("Could not open %s for writing\n", fileName.c_str());
+		return;
+	}
+	writer.bytes += fwrite(block.text.data(), 1, block.text.size(), out);
+	fclose(out);
+}
+
+static void syncRun(resultsWriter& writer, int run)
+{
+	map<int, FILE*>::iterator it = writer.series.find(run);
+	if (it != writer.series.end() && it->second != NULL && (fflush(it->second) != 0 || fsync(fileno(it->second)) != 0))
+		printf("Could not write %s\n", seriesFileName(writer.simName, run, writer.options.csv).c_str());
+}
+
+static void endRun(resultsWriter& writer, int run)
+{
+	map<int, FILE*>::iterator it = writer.series.find(run);
+	if (it == writer.series.end())
+		return;
+	if (it->second != NULL)
+		fclose(it->second);
+	writer.series.erase(it);
+}
+
+static void writerLoop(resultsWriter& writer)
+{
+	if (traceOn.load(memory_order_relaxed))
+		traceThreadName("results writer");
+	unique_lock<mutex> guard(writer.lock);
+	while (true)
+	{
+		writer.ready.wait(guard, [&] { return !writer.queue.empty() || writer.closing; });
+		if (writer.queue.empty())
+			break;
+		resultsBlock* block = writer.queue.front();
+		writer.queue.pop_front();
+
+		// the disk is only touched with the lock released
+		guard.unlock();
+		{
+			TRACE_SCOPE("write block");
+			if (block->kind == BLOCK_SERIES)
+				writeSeries(writer, *block);
+			else if (block->kind == BLOCK_SUMMARY)
+				writeSummary(writer, *block);
+			else if (block->kind == BLOCK_RESUME)
+				openSeries(writer, block->run, true);
+			else if (block->kind == BLOCK_SYNC)
+				syncRun(writer, block->run);
+			else
+				endRun(writer, block->run);
+		}
+		guard.lock();
+
+		writer.spare.push_back(block);
+		writer.done++;
+		writer.written.notify_all();
+	}
+}
+
+void startResults(resultsWriter& writer, const string& simName, const resultsOptions& options)
+{
+	writer.simName = simName;
+	writer.options = options;
+	writer.closing = false;
+	writer.bytes = 0;
+	writer.submitted = 0;
+	writer.done = 0;
+	writer.worker = thread(writerLoop, ref(writer));
+}
+
+resultsBlock* takeBlock(resultsWriter& writer, int run, int kind)
+{
+	resultsBlock* block = NULL;
+	{
+		lock_guard<mutex> guard(writer.lock);
+		if (!writer.spare.empty())
+		{
+			block = writer.spare.back();
+			writer.spare.pop_back();
+		}
+	}
+	if (block == NULL)
+		block = new resultsBlock;
+
+	block->run = run;
+	block->kind = kind;
+	block->time.clear();
+	block->tile.clear();
+	block->arrivals.clear();
+	block->served.clear();
+	block->dropped.clear();
+	block->blocked.clear();
+	block->queued.clear();
+	block->text.clear();
+	return block;
+}
+
+// queue a block; returns its place in the queue order, for waiting on it
+static long long queueBlock(resultsWriter& writer, resultsBlock* block)
+{
+	long long ticket;
+	{
+		lock_guard<mutex> guard(writer.lock);
+		writer.queue.push_back(block);
+		ticket = ++writer.submitted;
+	}
+	writer.ready.notify_one();
+	return ticket;
+}
+
+void submitBlock(resultsWriter& writer, resultsBlock* block)
+{
+	queueBlock(writer, block);
+}
+
+void syncSeries(resultsWriter& writer, int run)
+{
+	long long ticket = queueBlock(writer, takeBlock(writer, run, BLOCK_SYNC));
+	unique_lock<mutex> guard(writer.lock);
+	writer.written.wait(guard, [&] { return writer.done >= ticket; });
+}
+
+bool trimSeries(const string& simName, int run, bool csv, uint64_t rows)
+{
+	string fileName = seriesFileName(simName, run, csv);
+	FILE* in = fopen(fileName.c_str(), "rb");
+	if (in == NULL)
+	{
+		printf("Could not open %s\n", fileName.c_str());
+		return false;
+	}
+
+	// the end of the header and of the first "rows" rows
+	bool found = false;
+	long long offset = 0;
+	if (csv)
+	{
+		// one header line, then one line per row
+		vector<char> buffer(1 << 16);
+		uint64_t lines = 0;
+		size_t got;
+		while (!found && (got = fread(buffer.data(), 1, buffer.size(), in)) > 0)
+		{
+			for (size_t i = 0; i < got && !found; i++)
+			{
+				if (buffer[i] == '\n' && ++lines == rows + 1)
+				{
+					offset += i + 1;
+					found = true;
+				}
+			}
+			if (!found)
+				offset += got;
+		}
+	}
+	else
+	{
+		// the writer only cuts blocks at snapshots, so the rows end on a block
+		char magic[4];
+		uint32_t version;
+		double interval;
+		found = (fread(magic, 4, 1, in) == 1 && memcmp(magic, "SHNR", 4) == 0 && fread(&version, sizeof(version), 1, in) == 1 && version == RESULTS_VERSION && fread(&interval, sizeof(interval), 1, in) == 1);
+		offset = RESULTS_HEADER_BYTES;
+		uint64_t total = 0;
+		uint32_t blockRows;
+		while (found && total < rows)
+		{
+			found = (fseek(in, offset, SEEK_SET) == 0 && fread(&blockRows, sizeof(blockRows), 1, in) == 1);
+			offset += sizeof(blockRows) + (long long)blockRows * RESULTS_ROW_BYTES;
+			total += blockRows;
+		}
+		found = found && total == rows && fseek(in, 0, SEEK_END) == 0 && ftell(in) >= offset;
+	}
+	fclose(in);
+	if (!found || truncate(fileName.c_str(), offset) != 0)
+	{
+		printf("%s does not hold the %llu rows written before the run's snapshot\n", fileName.c_str(), (unsigned long long)rows);
+		return false;
+	}
+	return true;
+}
+
+void stopResults(resultsWriter& writer)
+{
+	{
+		lock_guard<mutex> guard(writer.lock);
+		writer.closing = true;
+	}
+	writer.ready.notify_one();
+	writer.worker.join();
+
+	for (map<int, FILE*>::iterator it = writer.series.begin(); it != writer.series.end(); ++it)
+	{
+		if (it->second != NULL)
+			fclose(it->second);
+	}
+	writer.series.clear();
+	for (int i = 0; i < (int)writer.spare.size(); i++)
+	{
+		delete writer.spare[i];
+	}
+	writer.spare.clear();
+}
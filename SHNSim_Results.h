@@ -0,0 +1,106 @@
+#ifndef SHNSIM_RESULTS_H
+#define SHNSIM_RESULTS_H
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <condition_variable>
+#include <stdio.h>
+#include <stdint.h>
+
+// per-tile time series written while a batch runs (interval 0 turns it off)
+// and snapshots to resume runs from (checkpoint 0 turns them off)
+struct resultsOptions
+{
+	double interval = 0;	// simulated seconds between samples
+	bool csv = false;	// CSV instead of columnar binary
+	double checkpoint = 0;	// simulated seconds between snapshots, see SHNSim_Checkpoint.h
+	int regions = 1;	// threads sharing every run, see SHNSim_Regions.h
+};
+
+// Time series file "<simName>_<run>_series.bin", in native byte order:
+//   char magic[4] = "SHNR", uint32 version = RESULTS_VERSION, double interval
+//   then blocks of: uint32 rows, double time[rows], int32 tile[rows],
+//   int64 arrivals[rows], served[rows], dropped[rows], blocked[rows], int32 queued[rows]
+// "<simName>_<run>_series.csv" holds the same columns as text.
+// Every snapshot of a run ends a block and waits for the file to be on disk;
+// a run resumed from a snapshot cuts the file back to the rows it counted
+static const uint32_t RESULTS_VERSION = 1;
+static const size_t RESULTS_HEADER_BYTES = 4 + sizeof(uint32_t) + sizeof(double);
+static const size_t RESULTS_ROW_BYTES = sizeof(double) + 2 * sizeof(int32_t) + 4 * sizeof(int64_t);
+static const int RESULTS_BLOCK_ROWS = 1 << 16;
+
+enum resultsBlockKind
+{
+	BLOCK_SERIES,	// rows of the run's time series
+	BLOCK_SUMMARY,	// text of the run's per-tile summary CSV
+	BLOCK_END,	// the run is over; its series file is closed
+	BLOCK_RESUME,	// the run resumed from a snapshot; its series file, cut back with trimSeries(), is appended to
+	BLOCK_SYNC	// everything of the run queued before is flushed to disk, see syncSeries()
+};
+
+// buffer handed from a simulation thread to the writer thread; the columns are
+// only filled for BLOCK_SERIES and text only for BLOCK_SUMMARY
+struct resultsBlock
+{
+	int run;
+	int kind;
+	std::vector<double> time;
+	std::vector<int32_t> tile;
+	std::vector<long long> arrivals, served, dropped, blocked;
+	std::vector<int32_t> queued;
+	std::string text;
+
+	int rows() const { return (int)time.size(); }
+};
+
+// writer thread and the queue of filled blocks it drains; simulation threads
+// only ever hold the lock long enough to move a pointer, never across a write
+struct resultsWriter
+{
+	std::string simName;
+	resultsOptions options;
+	std::thread worker;
+	std::mutex lock;
+	std::condition_variable ready;
+	std::deque<resultsBlock*> queue;
+	std::vector<resultsBlock*> spare;	// written blocks, reused by takeBlock()
+	bool closing = false;
+	std::map<int, FILE*> series;	// open series file of every running run (writer thread only)
+	std::atomic<long long> bytes{0};	// bytes written so far
+	std::condition_variable written;
+	long long submitted = 0, done = 0;	// blocks queued and blocks written, in queue order
+};
+
+// file a run's per-tile summary is written to: "<simName>_<run>.csv"
+std::string runFileName(const std::string& simName, int run);
+
+// file a run's time series is written to
+std::string seriesFileName(const std::string& simName, int run, bool csv);
+
+// start the writer thread of a batch
+void startResults(resultsWriter& writer, const std::string& simName, const resultsOptions& options);
+
+// empty block for "run"; reuses a written block or allocates one, so it never waits for the disk
+resultsBlock* takeBlock(resultsWriter& writer, int run, int kind);
+
+// queue a block for writing; the caller must not touch it afterwards
+void submitBlock(resultsWriter& writer, resultsBlock* block);
+
+// hand the run's series file over to disk up to the last block queued, and
+// wait until it is there; a snapshot taken afterwards can trust its row count
+void syncSeries(resultsWriter& writer, int run);
+
+// cut a run's series file back to its header and first "rows" rows, so a run
+// resumed from a snapshot taken with that many rows written can append to it;
+// false (with a message on stdout) if the file does not hold that many
+bool trimSeries(const std::string& simName, int run, bool csv, uint64_t rows);
+
+// write everything still queued, then stop the writer thread
+void stopResults(resultsWriter& writer);
+
+#endif
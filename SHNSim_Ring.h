@@ -0,0 +1,62 @@
+#ifndef SHNSIM_RING_H
+#define SHNSIM_RING_H
+
+#include <atomic>
+#include <vector>
+#include <cstddef>
+
+// lock-free single-producer/single-consumer ring buffer; push() never blocks
+// and fails when the ring is full, so the producer can simply drop the item
+template <class T>
+struct spscRing
+{
+	explicit spscRing(size_t capacity)
+	{
+		size_t size = 2;
+		while (size < capacity)
+			size *= 2;
+		slots.resize(size);
+		mask = size - 1;
+	}
+
+	// producer side
+	bool push(const T& item)
+	{
+		size_t h = head.load(std::memory_order_relaxed);
+		if (h - tailCache == slots.size())
+		{
+			tailCache = tail.load(std::memory_order_acquire);
+			if (h - tailCache == slots.size())
+				return false;
+		}
+		slots[h & mask] = item;
+		head.store(h + 1, std::memory_order_release);
+		return true;
+	}
+
+	// consumer side
+	bool pop(T& item)
+	{
+		size_t t = tail.load(std::memory_order_relaxed);
+		if (t == headCache)
+		{
+			headCache = head.load(std::memory_order_acquire);
+			if (t == headCache)
+				return false;
+		}
+		item = slots[t & mask];
+		tail.store(t + 1, std::memory_order_release);
+		return true;
+	}
+
+	std::vector<T> slots;
+	size_t mask;
+
+	// producer and consumer indices live on separate cache lines
+	alignas(64) std::atomic<size_t> head{0};
+	size_t tailCache = 0;	// producer's last view of tail
+	alignas(64) std::atomic<size_t> tail{0};
+	size_t headCache = 0;	// consumer's last view of head
+};
+
+#endif
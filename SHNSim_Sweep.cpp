@@ -0,0 +1,386 @@
+#include "SHNSim_Sweep.h"
+#include "SHNSim_Trace.h"
+#include "SHNSim_Healing.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <atomic>
+#include <sstream>
+#include <thread>
+
+using namespace std;
+
+static const int SWEEP_MAX_VALUES = 10000;
+
+// index into SWEEP_NAMES, as setParam() takes it
+static int sweepParam(const string& name)
+{
+	for (int i = 0; i < SWEEP_PARAMS; i++)
+	{
+		if (name == SWEEP_NAMES[i])
+			return i;
+	}
+	return -1;
+}
+
+static void setParam(simParams& params, int param, double value)
+{
+	switch (param)
+	{
+		case 0: params.bsLen = (int)value; break;
+		case 1: params.antNum = (int)value; break;
+		case 2: params.transNum = (int)value; break;
+		case 3: params.transDist = value; break;
+		case 4: params.dRateMax = (int)value; break;
+		case 5: params.uePerAnt = (int)value; break;
+		default: params.bufSize = (int)value; break;
+	}
+}
+
+double sweepValue(const simParams& params, const string& name)
+{
+	switch (sweepParam(name))
+	{
+		case 0: return params.bsLen;
+		case 1: return params.antNum;
+		case 2: return params.transNum;
+		case 3: return params.transDist;
+		case 4: return params.dRateMax;
+		case 5: return params.uePerAnt;
+		default: return params.bufSize;
+	}
+}
+
+static bool parseValue(const string& text, double& value)
+{
+	char* end;
+	value = strtod(text.c_str(), &end);
+	return !text.empty() && *end == '\0' && isfinite(value);
+}
+
+bool checkSweepOptions(const resultsOptions& series)
+{
+	const char* unsupported = NULL;
+	if (series.interval > 0)
+		unsupported = "seriesInterval";	// seriesCsv only picks the format of a series
+	else if (series.checkpoint > 0)
+		unsupported = "checkpointInterval";
+	else if (series.regions > 1)
+		unsupported = "regions";
+	if (unsupported != NULL)
+		printf("%s cannot be used with a sweep\n", unsupported);
+	return unsupported == NULL;
+}
+
+bool isSweepText(const string& text)
+{
+	return text.find(',') != string::npos || text.find(':') != string::npos;
+}
+
+bool parseSweepValues(const string& name, const string& text, vector<double>& values)
+{
+	int param = sweepParam(name);
+	if (param == -1)
+	{
+		printf("%s cannot be swept (bsLen, antNum, transNum, transDist, dRateMax, uePerAnt and bufSize can)\n", name.c_str());
+		return false;
+	}
+
+	values.clear();
+	bool ok = true;
+	if (text.find(':') != string::npos)
+	{
+		// first:last:step, last included
+		stringstream fields(text);
+		string first, last, step, rest;
+		double a, b, s;
+		ok = getline(fields, first, ':') && getline(fields, last, ':') && getline(fields, step, ':') && !getline(fields, rest)
+			&& parseValue(first, a) && parseValue(last, b) && parseValue(step, s) && s > 0 && b >= a && (b - a) / s < SWEEP_MAX_VALUES;
+		for (int i = 0; ok && a + i * s <= b + s * 1e-9; i++)
+		{
+			values.push_back(a + i * s);
+		}
+	}
+	else
+	{
+		stringstream fields(text);
+		string field;
+		double v;
+		while (ok && getline(fields, field, ','))
+		{
+			ok = parseValue(field, v) && (int)values.size() < SWEEP_MAX_VALUES;
+			values.push_back(v);
+		}
+	}
+	for (int i = 0; ok && i < (int)values.size(); i++)
+	{
+		ok = (param == 3 || values[i] == floor(values[i]));
+	}
+	if (!ok || values.empty())
+	{
+		printf("%s: \"%s\" is not a list (a,b,c) or range (first:last:step) of %s values\n", name.c_str(), text.c_str(), (param == 3 ? "numeric" : "whole"));
+		return false;
+	}
+	return true;
+}
+
+bool sweepAxes(const vector<pair<string, string>>& sweep, vector<sweepAxis>& axes)
+{
+	axes.clear();
+	for (int i = 0; i < (int)sweep.size(); i++)
+	{
+		sweepAxis axis;
+		axis.name = sweep[i].first;
+		if (!parseSweepValues(axis.name, sweep[i].second, axis.values))
+			return false;
+		axes.push_back(axis);
+	}
+	return true;
+}
+
+vector<simParams> sweepPoints(const simParams& base, const vector<sweepAxis>& axes)
+{
+	vector<simParams> points = {base};
+	for (int a = 0; a < (int)axes.size(); a++)
+	{
+		int param = sweepParam(axes[a].name);
+		vector<simParams> next;
+		for (int p = 0; p < (int)points.size(); p++)
+		{
+			for (int v = 0; v < (int)axes[a].values.size(); v++)
+			{
+				next.push_back(points[p]);
+				setParam(next.back(), param, axes[a].values[v]);
+			}
+		}
+		points.swap(next);
+	}
+	return points;
+}
+
+template <class T>
+static void hashValue(uint64_t& h, const T& value)
+{
+	h = hashBytes(h, &value, sizeof(value));
+}
+
+uint64_t resultKey(const simTopology& topo, const simParams& params, unsigned long long seed)
+{
+	uint64_t h = 0x13198A2E03707344ULL;
+	hashValue(h, SWEEP_CACHE_VERSION);
+	h = hashBytes(h, topo.state.data(), topo.state.size() * sizeof(int));
+	for (int t = 0; t < (int)topo.neighbors.size(); t++)
+	{
+		h = hashBytes(h, topo.neighbors[t].data(), topo.neighbors[t].size() * sizeof(pair<int, int>));
+	}
+	// handovers only change the run with self-healing on; fields one by one,
+	// since (int, double) pairs have padding
+	if (params.selfHealing)
+	{
+		for (int t = 0; t < (int)topo.handover.size(); t++)
+		{
+			for (int i = 0; i < (int)topo.handover[t].size(); i++)
+			{
+				hashValue(h, topo.handover[t][i].first);
+				hashValue(h, topo.handover[t][i].second);
+			}
+			hashValue(h, t);
+		}
+	}
+	hashValue(h, params.bsLen);
+	hashValue(h, params.antNum);
+	hashValue(h, params.transNum);
+	hashValue(h, params.transDist);
+	hashValue(h, params.dRateMax);
+	hashValue(h, params.uePerAnt);
+	hashValue(h, params.simLen);
+	hashValue(h, params.bufSize);
+	hashValue(h, params.selfHealing);
+	hashValue(h, seed);
+	return h;
+}
+
+string resultFileName(const string& cacheDir, uint64_t key)
+{
+	char name[32];
+	snprintf(name, sizeof(name), "%016llx.csv", (unsigned long long)key);
+	return cacheDir + "/" + name;
+}
+
+// totals from the first line of a cache file; false if it is missing or not the run's
+static bool loadResult(const string& fileName, uint64_t key, runSummary& sum)
+{
+	FILE* in = fopen(fileName.c_str(), "r");
+	if (in == NULL)
+		return false;
+	unsigned long long fileKey;
+	tileStats& t = sum.total;
+	int fields = fscanf(in, "# key %llx events %lld wallSeconds %lf arrivals %lld served %lld dropped %lld blocked %lld delaySum %lf", &fileKey, &sum.events, &sum.wallSeconds, &t.arrivals, &t.served, &t.dropped, &t.blocked, &t.delaySum);
+	fclose(in);
+	return fields == 8 && fileKey == key;
+}
+
+static bool saveResult(const string& fileName, uint64_t key, const runSummary& sum, const string& text)
+{
+	// written under another name and renamed, so a cache file is always complete
+	string temp = fileName + ".tmp";
+	FILE* out = fopen(temp.c_str(), "w");
+	if (out == NULL)
+	{
+		printf("Could not open %s for writing\n", temp.c_str());
+		return false;
+	}
+	const tileStats& t = sum.total;
+	fprintf(out, "# key %016llx events %lld wallSeconds %.17g arrivals %lld served %lld dropped %lld blocked %lld delaySum %.17g\n", (unsigned long long)key, sum.events, sum.wallSeconds, t.arrivals, t.served, t.dropped, t.blocked, t.delaySum);
+	fwrite(text.data(), 1, text.size(), out);
+	bool ok = (fclose(out) == 0);
+	if (!ok || rename(temp.c_str(), fileName.c_str()) != 0)
+	{
+		printf("Could not write %s\n", fileName.c_str());
+		remove(temp.c_str());
+		return false;
+	}
+	return true;
+}
+
+static void writeSweep(const string& fileName, const vector<simParams>& points, const vector<sweepResult>& results, const vector<uint64_t>& keys, const string& cacheDir)
+{
+	FILE* out = fopen(fileName.c_str(), "w");
+	if (out == NULL)
+	{
+		printf("Could not open %s for writing\n", fileName.c_str());
+		return;
+	}
+	fprintf(out, "point,bsLen,antNum,transNum,transDist,dRateMax,uePerAnt,bufSize,run,cached,arrivals,served,dropped,blocked,meanDelay,resultFile\n");
+	for (int i = 0; i < (int)results.size(); i++)
+	{
+		const sweepResult& r = results[i];
+		if (!r.done)
+			continue;
+		const simParams& p = points[r.point];
+		const tileStats& t = r.summary.total;
+		fprintf(out, "%i,%i,%i,%i,%.17g,%i,%i,%i,%i,%i,%lld,%lld,%lld,%lld,%.17g,%s\n", r.point, p.bsLen, p.antNum, p.transNum, p.transDist, p.dRateMax, p.uePerAnt, p.bufSize, r.summary.run, (int)r.cached, t.arrivals, t.served, t.dropped, t.blocked, (t.served > 0 ? t.delaySum / t.served : 0.0), resultFileName(cacheDir, keys[i]).c_str());
+	}
+	fclose(out);
+}
+
+// a point with self-healing on plans the handovers for its own parameters
+static simTopology pointTopology(const simTopology& topo, const simParams& params)
+{
+	simTopology own = topo;
+	healPlan plan;
+	initHealing(plan, topo, params);
+	applyHealing(plan, own);
+	return own;
+}
+
+// arguments shared by all workers of a sweep
+struct sweepJob
+{
+	const simTopology& topo;
+	const vector<simTopology>& healed;	// pointTopology() of every self-healing point, built once
+	const vector<simParams>& points;
+	int firstRun;
+	int runs;
+	const vector<int>& tasks;	// indices into results still to be run
+	atomic<int>& next;
+	vector<sweepResult>& results;
+	const vector<uint64_t>& keys;
+	const string& cacheDir;
+	batchProgress* progress;
+};
+
+static void sweepWorker(sweepJob& job)
+{
+	simEngine eng;
+	string text;
+	int i;
+	while ((i = job.next.fetch_add(1, memory_order_relaxed)) < (int)job.tasks.size())
+	{
+		TRACE_SCOPE("sweep run");
+		int index = job.tasks[i];
+		const simParams& params = job.points[index / job.runs];
+		int run = job.firstRun + index % job.runs;
+		const simTopology& topo = (params.selfHealing ? job.healed[index / job.runs] : job.topo);
+		if (job.progress == NULL)
+		{
+			runSimulation(eng, topo, params, runSeed(run));
+		}
+		else
+		{
+			// in slices, so a cancel does not wait for the whole run
+			initSimulation(eng, topo, params, runSeed(run));
+			bool more = true;
+			long long reported = 0, reportedAllocations = 0;
+			while (more && !job.progress->cancel.load(memory_order_relaxed))
+			{
+				more = stepSimulation(eng, eng.now + job.progress->interval);
+				job.progress->events.fetch_add(eng.events - reported, memory_order_relaxed);
+				job.progress->allocations.fetch_add(eng.allocations - reportedAllocations, memory_order_relaxed);
+				reported = eng.events;
+				reportedAllocations = eng.allocations;
+			}
+			if (more)
+				return;
+			job.progress->runsDone.fetch_add(1, memory_order_relaxed);
+		}
+
+		sweepResult& result = job.results[index];
+		result.summary = summarizeRun(eng, run);
+		result.done = true;
+		formatRun(eng, text);
+		saveResult(resultFileName(job.cacheDir, job.keys[index]), job.keys[index], result.summary, text);
+	}
+}
+
+vector<sweepResult> runSweep(const simTopology& topo, const vector<simParams>& points, const string& simName, int firstRun, int runs, int threads, const string& cacheDir, batchProgress* progress)
+{
+	runs = max(0, runs);
+	vector<sweepResult> results(points.size() * runs);
+	vector<uint64_t> keys(results.size());
+	vector<int> tasks;
+	vector<simTopology> healed(points.size());
+	for (int i = 0; i < (int)results.size(); i++)
+	{
+		const simParams& params = points[i / runs];
+		if (params.selfHealing && i % runs == 0)
+			healed[i / runs] = pointTopology(topo, params);
+		int run = firstRun + i % runs;
+		results[i].point = i / runs;
+		keys[i] = resultKey(params.selfHealing ? healed[i / runs] : topo, params, runSeed(run));
+		if (loadResult(resultFileName(cacheDir, keys[i]), keys[i], results[i].summary))
+		{
+			results[i].summary.run = run;
+			results[i].cached = true;
+			results[i].done = true;
+			if (progress != NULL)
+				progress->runsDone.fetch_add(1, memory_order_relaxed);
+		}
+		else
+		{
+			tasks.push_back(i);
+		}
+	}
+
+	if (!tasks.empty())
+	{
+		mkdir(cacheDir.c_str(), 0777);	// fails harmlessly if it exists
+		threads = batchThreads(threads, (int)tasks.size());
+		atomic<int> next(0);
+		sweepJob job = {topo, healed, points, firstRun, runs, tasks, next, results, keys, cacheDir, progress};
+		vector<thread> pool;
+		for (int t = 1; t < threads; t++)
+		{
+			pool.push_back(thread(sweepWorker, ref(job)));
+		}
+		sweepWorker(job);
+		for (int t = 0; t < (int)pool.size(); t++)
+		{
+			pool[t].join();
+		}
+	}
+	writeSweep(simName + "_sweep.csv", points, results, keys, cacheDir);
+	return results;
+}
@@ -0,0 +1,80 @@
+#ifndef SHNSIM_SWEEP_H
+#define SHNSIM_SWEEP_H
+
+#include <string>
+#include <vector>
+#include <utility>
+#include <stdint.h>
+#include "SHNSim_Engine.h"
+#include "SHNSim_Batch.h"
+
+// Parameter sweeps: any of bsLen, antNum, transNum, transDist, dRateMax,
+// uePerAnt and bufSize can be given a list ("3,4,6") or an inclusive range
+// ("80:200:40") of values; every combination of the values (a point) is run
+// for every replication of the batch.
+//
+// Finished runs are cached in SWEEP_CACHE_DIR, one "<key>.csv" per run, the key
+// being a hash of the topology, the parameters and the seed. The file holds the
+// run's per-tile summary CSV after a "#" line with its totals. A sweep only runs
+// the points and replications that are not in the cache yet
+
+static const char* const SWEEP_CACHE_DIR = "shnsim_cache";
+
+// parameters a sweep can vary, also the entry boxes of the GUI that take a
+// list or range; the integer ones only take whole values
+static const int SWEEP_PARAMS = 7;
+static const char* const SWEEP_NAMES[SWEEP_PARAMS] = {"bsLen", "antNum", "transNum", "transDist", "dRateMax", "uePerAnt", "bufSize"};
+
+// part of every key; bump it whenever a change of the engine changes results,
+// so runs cached by the old engine are not reused
+static const uint32_t SWEEP_CACHE_VERSION = 2;
+
+struct sweepAxis
+{
+	std::string name;
+	std::vector<double> values;
+};
+
+// outcome of one point and replication of a sweep
+struct sweepResult
+{
+	int point = 0;
+	bool cached = false;	// taken from the cache instead of simulated
+	bool done = false;	// false if the sweep was cancelled before the run finished
+	runSummary summary;
+};
+
+// a sweep only writes summaries: false (with a message on stdout) if "series"
+// asks for time series, snapshots or regions, which it does not do
+bool checkSweepOptions(const resultsOptions& series);
+
+// true if "text" holds more than a single value (a list or a range)
+bool isSweepText(const std::string& text);
+
+// values of a list or range; fails (with a message on stdout) on anything else,
+// on a non-integer value of an integer parameter and on more than 10000 values
+bool parseSweepValues(const std::string& name, const std::string& text, std::vector<double>& values);
+
+// axes of (parameter name, values text) pairs as stored in simSettings
+bool sweepAxes(const std::vector<std::pair<std::string, std::string>>& sweep, std::vector<sweepAxis>& axes);
+
+// cross product of the axes applied to "base"; the last axis varies fastest
+std::vector<simParams> sweepPoints(const simParams& base, const std::vector<sweepAxis>& axes);
+
+// value of a parameter that can be swept, by name
+double sweepValue(const simParams& params, const std::string& name);
+
+uint64_t resultKey(const simTopology& topo, const simParams& params, unsigned long long seed);
+
+// path of a run's cache file
+std::string resultFileName(const std::string& cacheDir, uint64_t key);
+
+// run replications firstRun .. firstRun + runs - 1 of every point on "threads"
+// workers (0 = one per core), taking what it can from the cache in cacheDir and
+// adding the rest. Results are returned point by point and written to
+// "<simName>_sweep.csv". topo is taken without a healing plan; with selfHealing
+// on, every point gets its own. progress only counts runs and events (no tile
+// samples)
+std::vector<sweepResult> runSweep(const simTopology& topo, const std::vector<simParams>& points, const std::string& simName, int firstRun, int runs, int threads, const std::string& cacheDir = SWEEP_CACHE_DIR, batchProgress* progress = NULL);
+
+#endif
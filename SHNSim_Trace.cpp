@@ -0,0 +1,150 @@
+#include "SHNSim_Trace.h"
+#include <stdio.h>
+#include <chrono>
+#include <deque>
+#include <mutex>
+
+using namespace std;
+
+// a thread's buffer grows in chunks, so recorded events never move; when all
+// chunks are used further events of that thread are dropped
+static const int TRACE_CHUNK = 1 << 14;
+static const int TRACE_CHUNKS = 1024;
+
+struct traceBuffer
+{
+	int tid;
+	string threadName;	// guarded by traceLock
+	atomic<long long> count{0};	// events published by the owner
+	traceEvent* chunks[TRACE_CHUNKS] = {};
+};
+
+atomic<bool> traceOn{false};
+
+static mutex traceLock;
+static vector<traceBuffer*> buffers;	// never freed, so a trace outlives its threads
+static deque<traceCounter> counters;	// deque, so counter addresses stay fixed
+static thread_local traceBuffer* mine = NULL;
+
+long long traceNow()
+{
+	static const chrono::steady_clock::time_point origin = chrono::steady_clock::now();
+	return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - origin).count();
+}
+
+void traceSetEnabled(bool on)
+{
+	traceNow();	// fix the time origin before the first event
+	traceOn.store(on, memory_order_relaxed);
+}
+
+static traceBuffer* ownBuffer()
+{
+	if (mine == NULL)
+	{
+		lock_guard<mutex> guard(traceLock);
+		mine = new traceBuffer;
+		mine->tid = (int)buffers.size() + 1;
+		buffers.push_back(mine);
+	}
+	return mine;
+}
+
+void traceRecord(const char* name, char phase, long long start, long long duration, long long value)
+{
+	traceBuffer* buffer = ownBuffer();
+	long long n = buffer->count.load(memory_order_relaxed);
+	int chunk = (int)(n / TRACE_CHUNK);
+	if (chunk >= TRACE_CHUNKS)
+		return;
+	if (buffer->chunks[chunk] == NULL)
+		buffer->chunks[chunk] = new traceEvent[TRACE_CHUNK];
+
+	traceEvent& e = buffer->chunks[chunk][n % TRACE_CHUNK];
+	e.name = name;
+	e.start = start;
+	e.duration = duration;
+	e.value = value;
+	e.phase = phase;
+	buffer->count.store(n + 1, memory_order_release);
+}
+
+void traceThreadName(const char* name)
+{
+	traceBuffer* buffer = ownBuffer();
+	lock_guard<mutex> guard(traceLock);
+	buffer->threadName = name;
+}
+
+traceCounter* traceCounterFor(const char* name)
+{
+	lock_guard<mutex> guard(traceLock);
+	for (int i = 0; i < (int)counters.size(); i++)
+	{
+		if (counters[i].name == name || string(counters[i].name) == name)
+			return &counters[i];
+	}
+	counters.emplace_back();
+	counters.back().name = name;
+	return &counters.back();
+}
+
+vector<pair<string, long long>> traceCounterValues()
+{
+	lock_guard<mutex> guard(traceLock);
+	vector<pair<string, long long>> values;
+	for (int i = 0; i < (int)counters.size(); i++)
+	{
+		values.push_back(make_pair(string(counters[i].name), counters[i].value.load(memory_order_relaxed)));
+	}
+	return values;
+}
+
+long long traceEventCount()
+{
+	lock_guard<mutex> guard(traceLock);
+	long long total = 0;
+	for (int i = 0; i < (int)buffers.size(); i++)
+	{
+		total += buffers[i]->count.load(memory_order_relaxed);
+	}
+	return total;
+}
+
+bool traceExport(const string& fileName)
+{
+	FILE* out = fopen(fileName.c_str(), "w");
+	if (out == NULL)
+	{
+		printf("Could not open %s for writing\n", fileName.c_str());
+		return false;
+	}
+
+	lock_guard<mutex> guard(traceLock);
+	fprintf(out, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n");
+	bool first = true;
+	for (int b = 0; b < (int)buffers.size(); b++)
+	{
+		const traceBuffer& buffer = *buffers[b];
+		if (!buffer.threadName.empty())
+		{
+			fprintf(out, "%s{\"ph\": \"M\", \"name\": \"thread_name\", \"pid\": 1, \"tid\": %i, \"args\": {\"name\": \"%s\"}}", (first ? "" : ",\n"), buffer.tid, buffer.threadName.c_str());
+			first = false;
+		}
+
+		// events below "count" are complete; the owner may still be appending
+		long long count = buffer.count.load(memory_order_acquire);
+		for (long long n = 0; n < count; n++)
+		{
+			const traceEvent& e = buffer.chunks[n / TRACE_CHUNK][n % TRACE_CHUNK];
+			if (e.phase == 'X')
+				fprintf(out, "%s{\"ph\": \"X\", \"name\": \"%s\", \"pid\": 1, \"tid\": %i, \"ts\": %.3f, \"dur\": %.3f}", (first ? "" : ",\n"), e.name, buffer.tid, e.start / 1e3, e.duration / 1e3);
+			else
+				fprintf(out, "%s{\"ph\": \"C\", \"name\": \"%s\", \"pid\": 1, \"tid\": %i, \"ts\": %.3f, \"args\": {\"value\": %lld}}", (first ? "" : ",\n"), e.name, buffer.tid, e.start / 1e3, e.value);
+			first = false;
+		}
+	}
+	fprintf(out, "\n]}\n");
+	fclose(out);
+	return true;
+}
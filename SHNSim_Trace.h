@@ -0,0 +1,78 @@
+#ifndef SHNSIM_TRACE_H
+#define SHNSIM_TRACE_H
+
+#include <string>
+#include <vector>
+#include <utility>
+#include <atomic>
+
+// Tracing of scoped timers and counters. Every thread appends to its own
+// buffer without taking a lock; a thread only locks once, when it records its
+// first event. Tracing is off until traceSetEnabled(true), and a disabled
+// scope costs one relaxed load. traceExport() writes everything recorded so far
+// as Chrome trace JSON (chrome://tracing, ui.perfetto.dev)
+
+// one recorded event; phase 'X' = timed scope, 'C' = counter value
+struct traceEvent
+{
+	const char* name;	// must be a string literal
+	long long start;	// ns since the first call of traceNow()
+	long long duration;
+	long long value;
+	char phase;
+};
+
+// named value that is kept live (for the diagnostics window) even while
+// tracing is off; added to the trace as a counter event while it is on
+struct traceCounter
+{
+	const char* name;
+	std::atomic<long long> value{0};
+};
+
+extern std::atomic<bool> traceOn;
+
+long long traceNow();
+void traceSetEnabled(bool on);
+void traceRecord(const char* name, char phase, long long start, long long duration, long long value);
+
+// name shown for the calling thread in the exported trace
+void traceThreadName(const char* name);
+
+// counter with this name, created on first use; the pointer stays valid
+traceCounter* traceCounterFor(const char* name);
+
+// current value of every counter, in creation order
+std::vector<std::pair<std::string, long long>> traceCounterValues();
+
+// events recorded so far by all threads
+long long traceEventCount();
+
+bool traceExport(const std::string& fileName);
+
+inline void traceSet(traceCounter* counter, long long value)
+{
+	counter->value.store(value, std::memory_order_relaxed);
+	if (traceOn.load(std::memory_order_relaxed))
+		traceRecord(counter->name, 'C', traceNow(), 0, value);
+}
+
+// records the time between its construction and destruction
+struct traceScope
+{
+	const char* name;
+	long long start;
+	explicit traceScope(const char* scopeName) : name(scopeName), start(traceOn.load(std::memory_order_relaxed) ? traceNow() : -1) {}
+	~traceScope()
+	{
+		if (start >= 0)
+			traceRecord(name, 'X', start, traceNow() - start, 0);
+	}
+};
+
+#define TRACE_JOIN2(a, b) a##b
+#define TRACE_JOIN(a, b) TRACE_JOIN2(a, b)
+#define TRACE_SCOPE(name) traceScope TRACE_JOIN(traceScope_, __LINE__)(name)
+#define TRACE_COUNTER(name, value) do { static traceCounter* counter_ = traceCounterFor(name); traceSet(counter_, (value)); } while (0)
+
+#endif